@@ -8,6 +8,7 @@
 
 #include <lsl/battle/ibattle.h>
 #include <lsl/user/user.h>
+#include <lslunitsync/unitsync.h>
 
 #include <boost/typeof/typeof.hpp>
 #include <boost/algorithm/string.hpp>
@@ -527,6 +528,8 @@ void Server::OnBattleOpened(const IBattlePtr battle)
 		battle->SetProxy(m_impl->m_relay_host_bot->Nick());
 		JoinBattle(battle, m_impl->m_last_relay_host_password); // autojoin relayed host battles
 	}
+	if (battle && !battle->GetHostMapName().empty())
+		usync().PrefetchBattleMap(battle->GetHostMapName(), battle->GetNumUsers());
 }
 
 void Server::OnBattleMapChanged(const IBattlePtr battle, UnitsyncMap map)
@@ -534,6 +537,7 @@ void Server::OnBattleMapChanged(const IBattlePtr battle, UnitsyncMap map)
 	if (!battle)
 		return;
 	battle->SetHostMap(map.name, map.hash);
+	usync().PrefetchBattleMap(map.name, battle->GetNumUsers());
 }
 
 void Server::OnBattleModChanged(const IBattlePtr battle, UnitsyncGame mod)
@@ -575,6 +579,8 @@ void Server::OnUserJoinedBattle(const IBattlePtr battle, const UserPtr user)
 		return;
 	if (battle->IsProxy())
 		m_impl->RelayCmd("SUPPORTSCRIPTPASSWORD"); // send flag to relayhost marking we support script passwords
+	if (!battle->GetHostMapName().empty())
+		usync().PrefetchBattleMap(battle->GetHostMapName(), battle->GetNumUsers()); // more users, higher weight
 }
 
 void Server::OnAcceptAgreement(const std::string& agreement)
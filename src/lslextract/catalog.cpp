@@ -0,0 +1,296 @@
+/* This file is part of the Springlobby (GPL v2 or later), see COPYING */
+
+#include "catalog.h"
+
+#include <cmath>
+#include <string.h>
+#include <lslunitsync/data.h>
+#include <lslunitsync/unitsync.h>
+#include <lslunitsync/mmoptionmodel.h>
+#include <lslutils/misc.h>
+
+namespace LSL
+{
+
+static const char CATALOG_MAGIC[] = "LSLCAT";
+static const unsigned short CATALOG_VERSION = 1;
+
+static std::string JsonEscape(const std::string& str)
+{
+	std::string ret;
+	ret.reserve(str.size() + 2);
+	ret += '"';
+	for (const char c : str) {
+		switch (c) {
+			case '"':
+				ret += "\\\"";
+				break;
+			case '\\':
+				ret += "\\\\";
+				break;
+			case '\n':
+				ret += "\\n";
+				break;
+			case '\r':
+				ret += "\\r";
+				break;
+			case '\t':
+				ret += "\\t";
+				break;
+			default:
+				if ((unsigned char)c < 0x20) {
+					char buf[8];
+					snprintf(buf, sizeof(buf), "\\u%04x", c);
+					ret += buf;
+				} else {
+					ret += c;
+				}
+		}
+	}
+	ret += '"';
+	return ret;
+}
+
+CatalogRecord::CatalogRecord()
+    : m_afterkey(false)
+{
+	m_json.reserve(4096);
+	m_bin.reserve(4096);
+}
+
+void CatalogRecord::Separator()
+{
+	if (m_afterkey) { // value of a key/value pair
+		m_afterkey = false;
+		return;
+	}
+	if (m_needsep.empty())
+		return;
+	if (m_needsep.back())
+		m_json += ',';
+	m_needsep.back() = true;
+}
+
+void CatalogRecord::RawInt(int val)
+{
+	const unsigned int v = val;
+	const char bytes[4] = {char(v & 0xff), char((v >> 8) & 0xff), char((v >> 16) & 0xff), char((v >> 24) & 0xff)};
+	m_bin.append(bytes, 4);
+}
+
+void CatalogRecord::RawString(const std::string& val)
+{
+	RawInt(val.size());
+	m_bin += val;
+}
+
+void CatalogRecord::Key(const std::string& key)
+{
+	Separator();
+	m_json += JsonEscape(key);
+	m_json += ':';
+	RawString(key);
+	m_afterkey = true;
+}
+
+void CatalogRecord::String(const std::string& val)
+{
+	Separator();
+	m_json += JsonEscape(val);
+	m_bin += 's';
+	RawString(val);
+}
+
+void CatalogRecord::Int(int val)
+{
+	Separator();
+	char buf[16];
+	snprintf(buf, sizeof(buf), "%d", val);
+	m_json += buf;
+	m_bin += 'i';
+	RawInt(val);
+}
+
+void CatalogRecord::Float(float val)
+{
+	Separator();
+	if (std::isfinite(val)) {
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%g", val);
+		m_json += buf;
+	} else {
+		m_json += "null"; // not representable in json
+	}
+	m_bin += 'f';
+	int bits;
+	memcpy(&bits, &val, sizeof(bits));
+	RawInt(bits);
+}
+
+void CatalogRecord::Bool(bool val)
+{
+	Separator();
+	m_json += val ? "true" : "false";
+	m_bin += 'b';
+	m_bin += char(val ? 1 : 0);
+}
+
+void CatalogRecord::BeginObject()
+{
+	Separator();
+	m_json += '{';
+	m_bin += '{';
+	m_needsep.push_back(false);
+}
+
+void CatalogRecord::EndObject()
+{
+	m_json += '}';
+	m_bin += '}';
+	m_needsep.pop_back();
+}
+
+void CatalogRecord::BeginArray()
+{
+	Separator();
+	m_json += '[';
+	m_bin += '[';
+	m_needsep.push_back(false);
+}
+
+void CatalogRecord::EndArray()
+{
+	m_json += ']';
+	m_bin += ']';
+	m_needsep.pop_back();
+}
+
+void CatalogRecord::MapInfo(const LSL::MapInfo& info)
+{
+	String("description", info.description);
+	String("author", info.author);
+	Int("tidalStrength", info.tidalStrength);
+	Int("gravity", info.gravity);
+	Float("maxMetal", info.maxMetal);
+	Int("extractorRadius", info.extractorRadius);
+	Int("minWind", info.minWind);
+	Int("maxWind", info.maxWind);
+	Int("width", info.width);
+	Int("height", info.height);
+	Key("positions");
+	BeginArray();
+	for (const StartPos& pos : info.positions) {
+		BeginObject();
+		Int("x", pos.x);
+		Int("y", pos.y);
+		EndObject();
+	}
+	EndArray();
+}
+
+//! writes the fields every option type has
+static void OptionCommon(CatalogRecord& rec, const mmOptionModel& opt, const std::string& type)
+{
+	rec.BeginObject();
+	rec.String("key", opt.key);
+	rec.String("name", opt.name);
+	rec.String("type", type);
+	rec.String("section", opt.section);
+	rec.String("description", opt.description);
+}
+
+void CatalogRecord::Options(const LSL::GameOptions& opts)
+{
+	BeginArray();
+	for (const auto& it : opts.bool_map) {
+		OptionCommon(*this, it.second, "bool");
+		Bool("default", it.second.def);
+		EndObject();
+	}
+	for (const auto& it : opts.float_map) {
+		OptionCommon(*this, it.second, "number");
+		Float("default", it.second.def);
+		Float("min", it.second.min);
+		Float("max", it.second.max);
+		Float("step", it.second.stepping);
+		EndObject();
+	}
+	for (const auto& it : opts.string_map) {
+		OptionCommon(*this, it.second, "string");
+		String("default", it.second.def);
+		Int("maxlen", it.second.max_len);
+		EndObject();
+	}
+	for (const auto& it : opts.list_map) {
+		OptionCommon(*this, it.second, "list");
+		String("default", it.second.def);
+		Key("items");
+		BeginArray();
+		for (const listItem& item : it.second.listitems) {
+			BeginObject();
+			String("key", item.key);
+			String("name", item.name);
+			String("description", item.desc);
+			EndObject();
+		}
+		EndArray();
+		EndObject();
+	}
+	for (const auto& it : opts.section_map) {
+		OptionCommon(*this, it.second, "section");
+		EndObject();
+	}
+	EndArray();
+}
+
+CatalogWriter::CatalogWriter()
+    : m_json(NULL)
+    , m_bin(NULL)
+{
+}
+
+CatalogWriter::~CatalogWriter()
+{
+	Close();
+}
+
+bool CatalogWriter::Open(const std::string& prefix)
+{
+	Close();
+	m_json = Util::lslopen(prefix + ".ndjson", "wb");
+	m_bin = Util::lslopen(prefix + ".bin", "wb");
+	if (m_json == NULL || m_bin == NULL) {
+		Close();
+		return false;
+	}
+	fwrite(CATALOG_MAGIC, 6, 1, m_bin);
+	const char version[2] = {char(CATALOG_VERSION & 0xff), char(CATALOG_VERSION >> 8)};
+	fwrite(version, 2, 1, m_bin);
+	return true;
+}
+
+void CatalogWriter::Close()
+{
+	if (m_json != NULL)
+		fclose(m_json);
+	if (m_bin != NULL)
+		fclose(m_bin);
+	m_json = NULL;
+	m_bin = NULL;
+}
+
+void CatalogWriter::Write(char kind, const CatalogRecord& record)
+{
+	boost::mutex::scoped_lock lock(m_lock);
+	if (!IsOpen())
+		return;
+	fwrite(record.Json().data(), record.Json().size(), 1, m_json);
+	fputc('\n', m_json);
+
+	const unsigned int len = record.Binary().size();
+	const char header[5] = {kind, char(len & 0xff), char((len >> 8) & 0xff), char((len >> 16) & 0xff), char((len >> 24) & 0xff)};
+	fwrite(header, sizeof(header), 1, m_bin);
+	fwrite(record.Binary().data(), len, 1, m_bin);
+}
+
+} // namespace LSL
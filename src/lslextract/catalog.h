@@ -0,0 +1,116 @@
+/* This file is part of the Springlobby (GPL v2 or later), see COPYING */
+
+#ifndef LSL_EXTRACT_CATALOG_H
+#define LSL_EXTRACT_CATALOG_H
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace LSL
+{
+struct GameOptions;
+struct MapInfo;
+
+/** One catalog entry (a map or a game), written as json and in binary form at the same time.
+ *
+ * The binary form mirrors the json structure, every value starts with a tag byte:
+ *   's' uint32 length + utf8 bytes
+ *   'i' int32
+ *   'f' float32
+ *   'b' uint8 (0 / 1)
+ *   '{' key/value pairs (key is uint32 length + bytes, without tag) terminated by '}'
+ *   '[' values terminated by ']'
+ * All numbers are little endian.
+ */
+class CatalogRecord : public boost::noncopyable
+{
+public:
+	CatalogRecord();
+
+	void Key(const std::string& key);
+	void String(const std::string& val);
+	void Int(int val);
+	void Float(float val);
+	void Bool(bool val);
+	void BeginObject();
+	void EndObject();
+	void BeginArray();
+	void EndArray();
+
+	//! convenience functions for key/value pairs inside an object
+	void String(const std::string& key, const std::string& val)
+	{
+		Key(key);
+		String(val);
+	}
+	void Int(const std::string& key, int val)
+	{
+		Key(key);
+		Int(val);
+	}
+	void Float(const std::string& key, float val)
+	{
+		Key(key);
+		Float(val);
+	}
+	void Bool(const std::string& key, bool val)
+	{
+		Key(key);
+		Bool(val);
+	}
+
+	void MapInfo(const LSL::MapInfo& info);
+	void Options(const LSL::GameOptions& opts);
+
+	const std::string& Json() const
+	{
+		return m_json;
+	}
+	const std::string& Binary() const
+	{
+		return m_bin;
+	}
+
+private:
+	void Separator();
+	void RawString(const std::string& val);
+	void RawInt(int val);
+
+	std::string m_json;
+	std::string m_bin;
+	//! true when the next value in the current object / array needs a leading ','
+	std::vector<bool> m_needsep;
+	bool m_afterkey;
+};
+
+/** Writes catalog records to <prefix>.ndjson (one json object per line) and <prefix>.bin.
+ * The binary file starts with the magic "LSLCAT", an uint16 format version and
+ * is followed by records: uint8 kind ('m' map / 'g' game), uint32 length, record data.
+ * Records are appended as they come in, so memory use doesn't depend on the number of archives.
+ */
+class CatalogWriter : public boost::noncopyable
+{
+public:
+	CatalogWriter();
+	~CatalogWriter();
+	bool Open(const std::string& prefix);
+	void Close();
+	bool IsOpen() const
+	{
+		return m_json != NULL;
+	}
+	//! thread safe
+	void Write(char kind, const CatalogRecord& record);
+
+private:
+	FILE* m_json;
+	FILE* m_bin;
+	boost::mutex m_lock;
+};
+
+} // namespace LSL
+
+#endif // LSL_EXTRACT_CATALOG_H
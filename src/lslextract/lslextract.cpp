@@ -3,8 +3,19 @@
 #include "lslutils/logging.h"
 #include "lslutils/type_forwards.h"
 #include "lslutils/config.h"
+#include "lslutils/misc.h"
+#include "catalog.h"
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <set>
+
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 
 void lsllogerror(const char* format, ...)
 {
@@ -40,46 +51,439 @@ void dump(LSL::StringVector& vec)
 	}
 }
 
-void GetMapInfo(LSL::StringVector& maps)
+//! command line settings
+struct Options
+{
+	Options()
+	    : workers(1)
+	    , resume(false)
+	    , changedonly(false)
+	{
+	}
+	int workers;	  ///< number of threads used for the map stage
+	bool resume;	  ///< skip archives listed in the checkpoint of an interrupted run
+	bool changedonly; ///< skip archives whose checksum matches the last complete run
+	std::string catalog; ///< prefix of the catalog files, empty to disable
+	std::string sharedcache; ///< read-only cache dir, files found there aren't extracted again
+	std::string cachedir;
+	std::string unitsync;
+};
+
+/** keeps track of the already extracted archives, one "kind name hash" line per archive.
+ *  Entries are appended (and flushed) as soon as an archive is done, so an interrupted
+ *  run can be resumed from the last finished archive. */
+class StateFile
+{
+public:
+	StateFile(const std::string& path)
+	    : m_path(path)
+	    , m_file(NULL)
+	{
+	}
+	~StateFile()
+	{
+		Close();
+	}
+	void Load()
+	{
+		FILE* f = LSL::Util::lslopen(m_path, "r");
+		if (f == NULL)
+			return;
+		char line[1024];
+		while (fgets(line, sizeof(line), f) != NULL) {
+			line[strcspn(line, "\r\n")] = 0;
+			m_entries.insert(line);
+		}
+		fclose(f);
+	}
+	bool Contains(const std::string& kind, const std::string& name, const std::string& hash) const
+	{
+		return m_entries.find(Key(kind, name, hash)) != m_entries.end();
+	}
+	//! truncate (append=false) or continue (append=true) the file on disk
+	bool Open(bool append)
+	{
+		m_file = LSL::Util::lslopen(m_path, append ? "a" : "w");
+		return m_file != NULL;
+	}
+	void Add(const std::string& kind, const std::string& name, const std::string& hash)
+	{
+		boost::mutex::scoped_lock lock(m_lock);
+		const std::string key = Key(kind, name, hash);
+		m_entries.insert(key);
+		if (m_file == NULL)
+			return;
+		fprintf(m_file, "%s\n", key.c_str());
+		fflush(m_file);
+	}
+	void Close()
+	{
+		if (m_file != NULL) {
+			fclose(m_file);
+			m_file = NULL;
+		}
+	}
+	void Remove()
+	{
+		Close();
+		remove(m_path.c_str());
+	}
+	//! atomically replace the file on disk with the given entries
+	static void Write(const std::string& path, const std::set<std::string>& entries)
+	{
+		const std::string tmp = path + ".tmp";
+		FILE* f = LSL::Util::lslopen(tmp, "w");
+		if (f == NULL) {
+			lsllogerror("Couldn't write %s", tmp.c_str());
+			return;
+		}
+		for (const std::string& entry : entries) {
+			fprintf(f, "%s\n", entry.c_str());
+		}
+		fclose(f);
+		boost::system::error_code ec;
+		boost::filesystem::rename(tmp, path, ec);
+	}
+	const std::set<std::string>& Entries() const
+	{
+		return m_entries;
+	}
+	static std::string Key(const std::string& kind, const std::string& name, const std::string& hash)
+	{
+		return kind + "\t" + name + "\t" + hash;
+	}
+
+private:
+	std::string m_path;
+	FILE* m_file;
+	std::set<std::string> m_entries;
+	boost::mutex m_lock;
+};
+
+//! per stage progress / throughput accounting
+class StageStats
 {
-	for(const std::string mapname: maps) {
-		lsllogdebug("Extracting %s", mapname.c_str());
-		LSL::usync().GetMetalmap(mapname, 512, 512);
-		LSL::usync().GetHeightmap(mapname, 512, 512);
-		LSL::usync().GetMinimap(mapname, 512, 512);
+public:
+	StageStats(const std::string& name, const std::string& cachedir, size_t total)
+	    : m_name(name)
+	    , m_cachedir(cachedir)
+	    , m_total(total)
+	    , m_done(0)
+	    , m_skipped(0)
+	    , m_start(std::chrono::steady_clock::now())
+	    , m_start_wall(time(NULL))
+	    , m_last_report(m_start)
+	{
+	}
+	void Skipped()
+	{
+		++m_skipped;
+	}
+	void Done(const std::string& item, const std::string& error)
+	{
+		boost::mutex::scoped_lock lock(m_lock);
+		++m_done;
+		if (!error.empty()) {
+			m_failures.push_back(item + ": " + error);
+		}
+		const auto now = std::chrono::steady_clock::now();
+		if (now - m_last_report > std::chrono::seconds(1) || m_done + m_skipped == m_total) {
+			m_last_report = now;
+			printf("[%s] %zu/%zu %.1f/s\n", m_name.c_str(), m_done + m_skipped, m_total, m_done / Elapsed(now));
+			fflush(stdout);
+		}
+	}
+	//! prints throughput and returns the number of failed items
+	size_t Summary() const
+	{
+		const double elapsed = Elapsed(std::chrono::steady_clock::now());
+		const unsigned long long bytes = BytesWrittenSince(m_cachedir, m_start_wall);
+		printf("[%s] %zu processed, %zu skipped, %zu failed in %.2fs: %.1f %s/s, %llu bytes written (%.1f KiB/s)\n",
+		       m_name.c_str(), m_done, (size_t)m_skipped, m_failures.size(), elapsed,
+		       m_done / elapsed, m_name.c_str(), bytes, bytes / 1024.0 / elapsed);
+		for (const std::string& failure : m_failures) {
+			printf("[%s] failed: %s\n", m_name.c_str(), failure.c_str());
+		}
+		return m_failures.size();
+	}
+
+private:
+	double Elapsed(const std::chrono::steady_clock::time_point& now) const
+	{
+		const double ret = std::chrono::duration<double>(now - m_start).count();
+		return std::max(ret, 0.001);
+	}
+	//! sum up size of all files in dir modified after since
+	static unsigned long long BytesWrittenSince(const std::string& dir, time_t since)
+	{
+		unsigned long long ret = 0;
+		boost::system::error_code ec;
+		boost::filesystem::directory_iterator it(dir, ec), end;
+		for (; !ec && it != end; it.increment(ec)) {
+			if (!boost::filesystem::is_regular_file(it->status()))
+				continue;
+			if (boost::filesystem::last_write_time(it->path(), ec) < since)
+				continue;
+			ret += boost::filesystem::file_size(it->path(), ec);
+		}
+		return ret;
+	}
+
+	const std::string m_name;
+	const std::string m_cachedir;
+	const size_t m_total;
+	size_t m_done;
+	std::atomic<size_t> m_skipped;
+	const std::chrono::steady_clock::time_point m_start;
+	const time_t m_start_wall;
+	std::chrono::steady_clock::time_point m_last_report;
+	LSL::StringVector m_failures;
+	boost::mutex m_lock;
+};
+
+std::string ExtractMap(const std::string& mapname)
+{
+	try {
+		if (!LSL::usync().GetMetalmap(mapname, 512, 512).isValid())
+			return "no metalmap";
+		if (!LSL::usync().GetHeightmap(mapname, 512, 512).isValid())
+			return "no heightmap";
+		if (!LSL::usync().GetMinimap(mapname, 512, 512).isValid())
+			return "no minimap";
 		LSL::usync().GetMap(mapname);
+	} catch (std::exception& e) {
+		return e.what();
 	}
+	return "";
 }
 
-void GetGameInfo(LSL::StringVector& games)
+std::string ExtractGame(const std::string& gamename)
 {
-	for(const std::string gamename: games) {
-		lsllogdebug("Extracting %s", gamename.c_str());
-		LSL::StringVector sides = LSL::usync().GetSides(gamename);
-		for(const std::string side: sides) {
-			LSL::usync().GetSidePicture(gamename, side);
-		}
+	try {
+		LSL::usync().GetSideAtlas(gamename);
 		LSL::usync().GetGameOptions(gamename);
+	} catch (std::exception& e) {
+		return e.what();
 	}
+	return "";
+}
+
+//! guards map options, fetching them isn't atomic in unitsync
+static boost::mutex s_mapoptions_lock;
+
+void CatalogMap(LSL::CatalogWriter& catalog, const std::string& mapname, const std::string& hash)
+{
+	LSL::CatalogRecord rec;
+	rec.BeginObject();
+	rec.String("name", mapname);
+	rec.String("checksum", hash);
+	rec.String("archive", LSL::usync().GetMapArchive(mapname));
+	rec.MapInfo(LSL::usync().GetMap(mapname).info);
+	rec.Key("options");
+	{
+		boost::mutex::scoped_lock lock(s_mapoptions_lock);
+		rec.Options(LSL::usync().GetMapOptions(mapname));
+	}
+	rec.Key("images");
+	rec.BeginObject();
+	const char* images[][2] = {{"minimap", ".minimap.png"}, {"metalmap", ".metalmap.png"}, {"heightmap", ".heightmap.png"}};
+	for (const auto& image : images) {
+		const std::string path = LSL::usync().GetMapImageCachePath(mapname, image[1]);
+		if (LSL::Util::FileExists(path))
+			rec.String(image[0], path);
+	}
+	rec.EndObject();
+	rec.EndObject();
+	catalog.Write('m', rec);
+}
+
+void CatalogGame(LSL::CatalogWriter& catalog, const std::string& gamename, const std::string& hash)
+{
+	LSL::CatalogRecord rec;
+	rec.BeginObject();
+	rec.String("name", gamename);
+	rec.String("checksum", hash);
+	rec.String("archive", LSL::usync().GetGameArchive(gamename));
+	const boost::shared_ptr<const LSL::SideAtlas> atlas = LSL::usync().GetSideAtlas(gamename);
+	const std::string atlaspath = LSL::usync().GetSideAtlasCachePath(gamename);
+	if (LSL::Util::FileExists(atlaspath))
+		rec.String("sideatlas", atlaspath);
+	rec.Key("sides");
+	rec.BeginArray();
+	for (const std::string& side : LSL::usync().GetSides(gamename)) {
+		rec.BeginObject();
+		rec.String("name", side);
+		const auto it = atlas->sides.find(boost::to_lower_copy(side));
+		if (it != atlas->sides.end()) {
+			// position of the picture in the side atlas
+			rec.Key("rect");
+			rec.BeginArray();
+			rec.Int(it->second.x);
+			rec.Int(it->second.y);
+			rec.Int(it->second.width);
+			rec.Int(it->second.height);
+			rec.EndArray();
+		}
+		rec.EndObject();
+	}
+	rec.EndArray();
+	rec.Key("options");
+	rec.Options(LSL::usync().GetGameOptions(gamename));
+	rec.EndObject();
+	catalog.Write('g', rec);
+}
+
+/** runs extract for every archive in names on the given number of threads,
+ * archives already extracted in a previous run are only added to the catalog
+ * @return number of failed archives */
+size_t RunStage(const std::string& kind, const LSL::StringVector& names, const LSL::StringMap& hashes,
+		StateFile& checkpoint, const StateFile& manifest, const Options& opts,
+		std::string (*extract)(const std::string&),
+		LSL::CatalogWriter& catalog, void (*write)(LSL::CatalogWriter&, const std::string&, const std::string&),
+		int workers)
+{
+	StageStats stats(kind, opts.cachedir, names.size());
+	std::atomic<size_t> next(0);
+	auto worker = [&]() {
+		for (size_t i = next++; i < names.size(); i = next++) {
+			const std::string& name = names[i];
+			const std::string& hash = hashes.find(name)->second;
+			if ((opts.resume && checkpoint.Contains(kind, name, hash)) ||
+			    (opts.changedonly && manifest.Contains(kind, name, hash))) {
+				stats.Skipped();
+			} else {
+				const std::string error = (*extract)(name);
+				if (error.empty()) {
+					checkpoint.Add(kind, name, hash);
+				}
+				stats.Done(name, error);
+			}
+			if (catalog.IsOpen()) {
+				try {
+					(*write)(catalog, name, hash);
+				} catch (std::exception& e) {
+					lsllogerror("Couldn't add %s to catalog: %s", name.c_str(), e.what());
+				}
+			}
+		}
+	};
+	boost::thread_group threads;
+	for (int i = 1; i < workers; i++) {
+		threads.create_thread(worker);
+	}
+	worker();
+	threads.join_all();
+	return stats.Summary();
 }
 
 void GetAIInfo()
 {
 }
 
+void Usage(const char* name)
+{
+	printf("Usage: %s [options] <cache dir> <unitsync path>\n", name);
+	printf("  -j <n>          number of worker threads used to extract maps (default 1)\n");
+	printf("  --resume        continue an interrupted run, skip archives already extracted\n");
+	printf("  --changed-only  only extract archives which changed since the last complete run\n");
+	printf("  --catalog <prefix>  write a catalog of all maps and games to <prefix>.ndjson and <prefix>.bin\n");
+	printf("  --shared-cache <dir>  read-only cache dir of another host, cache files found there are reused\n");
+}
+
+bool ParseOptions(int argc, char* argv[], Options& opts)
+{
+	LSL::StringVector positional;
+	for (int i = 1; i < argc; i++) {
+		const std::string arg = argv[i];
+		if (arg == "-j" && i + 1 < argc) {
+			opts.workers = std::max(1, atoi(argv[++i]));
+		} else if (arg.compare(0, 2, "-j") == 0 && arg.size() > 2) {
+			opts.workers = std::max(1, atoi(arg.c_str() + 2));
+		} else if (arg == "--resume") {
+			opts.resume = true;
+		} else if (arg == "--changed-only") {
+			opts.changedonly = true;
+		} else if (arg == "--catalog" && i + 1 < argc) {
+			opts.catalog = argv[++i];
+		} else if (arg == "--shared-cache" && i + 1 < argc) {
+			opts.sharedcache = argv[++i];
+		} else if (!arg.empty() && arg[0] == '-') {
+			return false;
+		} else {
+			positional.push_back(arg);
+		}
+	}
+	if (positional.size() != 2)
+		return false;
+	opts.cachedir = LSL::Util::EnsureDelimiter(positional[0]);
+	opts.unitsync = positional[1];
+	return true;
+}
+
 int main(int argc, char* argv[])
 {
-	if (argc != 3) {
-		printf("Usage: %s <cache dir> <unitsync path>\n", argv[0]);
+	Options opts;
+	if (!ParseOptions(argc, argv, opts)) {
+		Usage(argv[0]);
+		return 1;
+	}
+	LSL::Util::config().ConfigurePaths(opts.cachedir, opts.unitsync, "");
+	LSL::usync().SetSharedCachePath(opts.sharedcache);
+	if (!LSL::usync().LoadUnitSyncLib(opts.unitsync)) {
+		printf("Couldn't load unitsync from %s\n", opts.unitsync.c_str());
+		return 1;
+	}
+
+	StateFile checkpoint(opts.cachedir + "lslextract.checkpoint");
+	StateFile manifest(opts.cachedir + "lslextract.manifest");
+	if (opts.resume)
+		checkpoint.Load();
+	if (opts.changedonly)
+		manifest.Load();
+	if (!checkpoint.Open(opts.resume)) {
+		printf("Couldn't open checkpoint in %s\n", opts.cachedir.c_str());
 		return 1;
 	}
-	LSL::Util::config().ConfigurePaths(argv[1], argv[2], "");
-	LSL::usync().LoadUnitSyncLib(argv[2]);
 
-	LSL::StringVector maps = LSL::usync().GetMapList();
-	GetMapInfo(maps);
-	LSL::StringVector games = LSL::usync().GetGameList();
-	GetGameInfo(games);
+	const LSL::StringVector maps = LSL::usync().GetMapList();
+	LSL::StringMap maphashes;
+	for (const std::string& mapname : maps) {
+		maphashes[mapname] = LSL::usync().GetMapHash(mapname);
+	}
+	const LSL::StringVector games = LSL::usync().GetGameList();
+	LSL::StringMap gamehashes;
+	for (const std::string& gamename : games) {
+		gamehashes[gamename] = LSL::usync().GetGame(gamename).hash;
+	}
+
+	LSL::CatalogWriter catalog;
+	if (!opts.catalog.empty() && !catalog.Open(opts.catalog)) {
+		printf("Couldn't create catalog %s\n", opts.catalog.c_str());
+		return 1;
+	}
+
+	size_t failed = RunStage("maps", maps, maphashes, checkpoint, manifest, opts, &ExtractMap, catalog, &CatalogMap, opts.workers);
+	// games are processed serially, reading side pictures switches unitsync's current game
+	failed += RunStage("games", games, gamehashes, checkpoint, manifest, opts, &ExtractGame, catalog, &CatalogGame, 1);
+	catalog.Close();
 	//LSL::usync().
 	LSL::usync().FreeUnitSyncLib();
+
+	// the manifest describes the last complete run: keep entries of unchanged, skipped archives
+	std::set<std::string> done = checkpoint.Entries();
+	for (const std::string& entry : manifest.Entries()) {
+		const LSL::StringVector tokens = LSL::Util::StringTokenize(entry, "\t");
+		if (tokens.size() != 3)
+			continue;
+		const LSL::StringMap& hashes = (tokens[0] == "maps") ? maphashes : gamehashes;
+		const auto it = hashes.find(tokens[1]);
+		if (it != hashes.end() && it->second == tokens[2])
+			done.insert(entry);
+	}
+	StateFile::Write(opts.cachedir + "lslextract.manifest", done);
+	if (failed == 0) {
+		checkpoint.Remove();
+	}
+	printf("%zu archives failed\n", failed);
+	return failed == 0 ? 0 : 2;
 }
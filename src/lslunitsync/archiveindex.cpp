@@ -0,0 +1,159 @@
+/* This file is part of the Springlobby (GPL v2 or later), see COPYING */
+
+#include "archiveindex.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace LSL
+{
+
+static char Lower(char c)
+{
+	return std::tolower((unsigned char)c);
+}
+
+//! case insensitive, * and ? as in ArchiveIndex::FindGlob()
+static bool GlobMatch(const char* str, size_t strlen, const std::string& pattern)
+{
+	size_t s = 0;
+	size_t p = 0;
+	// position after the last * and the str position it was matched up to
+	size_t starp = std::string::npos;
+	size_t stars = 0;
+	while (s < strlen) {
+		if (p < pattern.size() && pattern[p] == '*') {
+			starp = ++p;
+			stars = s;
+		} else if (p < pattern.size() && (pattern[p] == '?' || Lower(pattern[p]) == Lower(str[s]))) {
+			p++;
+			s++;
+		} else if (starp != std::string::npos) {
+			// let the last * take one more character
+			p = starp;
+			s = ++stars;
+		} else {
+			return false;
+		}
+	}
+	while (p < pattern.size() && pattern[p] == '*')
+		p++;
+	return p == pattern.size();
+}
+
+ArchiveIndex::ArchiveIndex()
+{
+}
+
+ArchiveIndex::ArchiveIndex(const std::vector<std::pair<std::string, int>>& files)
+{
+	std::vector<size_t> order(files.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&files](size_t a, size_t b) {
+		const std::string& x = files[a].first;
+		const std::string& y = files[b].first;
+		return std::lexicographical_compare(x.begin(), x.end(), y.begin(), y.end(), [](char c, char d) { return Lower(c) < Lower(d); });
+	});
+	size_t total = 0;
+	for (const auto& file : files)
+		total += file.first.size();
+	m_names.reserve(total);
+	m_entries.reserve(files.size());
+	for (const size_t i : order) {
+		Entry entry;
+		entry.offset = m_names.size();
+		entry.length = files[i].first.size();
+		entry.size = files[i].second;
+		m_names.append(files[i].first);
+		m_entries.push_back(entry);
+	}
+}
+
+std::string ArchiveIndex::GetName(size_t index) const
+{
+	if (index >= m_entries.size())
+		return "";
+	return m_names.substr(m_entries[index].offset, m_entries[index].length);
+}
+
+int ArchiveIndex::GetSize(size_t index) const
+{
+	if (index >= m_entries.size())
+		return 0;
+	return m_entries[index].size;
+}
+
+int ArchiveIndex::Compare(const Entry& entry, const std::string& str, size_t len) const
+{
+	const size_t common = std::min<size_t>(std::min<size_t>(entry.length, len), str.size());
+	for (size_t i = 0; i < common; i++) {
+		const char a = Lower(m_names[entry.offset + i]);
+		const char b = Lower(str[i]);
+		if (a != b)
+			return (a < b) ? -1 : 1;
+	}
+	const size_t entrylen = std::min<size_t>(entry.length, len);
+	const size_t strlen = std::min(str.size(), len);
+	if (entrylen == strlen)
+		return 0;
+	return (entrylen < strlen) ? -1 : 1;
+}
+
+int ArchiveIndex::Find(const std::string& name) const
+{
+	const auto it = std::lower_bound(m_entries.begin(), m_entries.end(), name, [this](const Entry& entry, const std::string& str) {
+		return Compare(entry, str, std::string::npos) < 0;
+	});
+	if (it == m_entries.end() || Compare(*it, name, std::string::npos) != 0)
+		return -1;
+	return it - m_entries.begin();
+}
+
+void ArchiveIndex::PrefixRange(const std::string& prefix, size_t& first, size_t& last) const
+{
+	const size_t len = prefix.size();
+	const auto begin = std::lower_bound(m_entries.begin(), m_entries.end(), prefix, [this, len](const Entry& entry, const std::string& str) {
+		return Compare(entry, str, len) < 0;
+	});
+	const auto end = std::upper_bound(begin, m_entries.end(), prefix, [this, len](const std::string& str, const Entry& entry) {
+		return Compare(entry, str, len) > 0;
+	});
+	first = begin - m_entries.begin();
+	last = end - m_entries.begin();
+}
+
+StringVector ArchiveIndex::FindPrefix(const std::string& prefix) const
+{
+	size_t first;
+	size_t last;
+	PrefixRange(prefix, first, last);
+	StringVector ret;
+	ret.reserve(last - first);
+	for (size_t i = first; i < last; i++)
+		ret.push_back(GetName(i));
+	return ret;
+}
+
+StringVector ArchiveIndex::FindGlob(const std::string& pattern) const
+{
+	// only the entries starting with the part before the first wildcard can match
+	const std::string prefix = pattern.substr(0, pattern.find_first_of("*?"));
+	size_t first;
+	size_t last;
+	PrefixRange(prefix, first, last);
+	StringVector ret;
+	for (size_t i = first; i < last; i++) {
+		const Entry& entry = m_entries[i];
+		if (GlobMatch(m_names.data() + entry.offset, entry.length, pattern))
+			ret.push_back(GetName(i));
+	}
+	return ret;
+}
+
+size_t ArchiveIndex::GetMemoryUsage() const
+{
+	return m_entries.capacity() * sizeof(Entry) + m_names.capacity();
+}
+
+} // namespace LSL
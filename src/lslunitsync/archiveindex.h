@@ -0,0 +1,69 @@
+/* This file is part of the Springlobby (GPL v2 or later), see COPYING */
+
+#ifndef LSL_HEADERGUARD_ARCHIVEINDEX_H
+#define LSL_HEADERGUARD_ARCHIVEINDEX_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <boost/noncopyable.hpp>
+
+#include <lslutils/type_forwards.h>
+
+namespace LSL
+{
+
+/** \brief names and sizes of all files of an archive
+ *
+ * The names are kept sorted case insensitive in one string, like the VFS
+ * of spring all lookups ignore the case. Immutable once built, so it's
+ * shared between threads without locking.
+ */
+class ArchiveIndex : public boost::noncopyable
+{
+public:
+	ArchiveIndex();
+	//! files are name, size pairs in any order
+	explicit ArchiveIndex(const std::vector<std::pair<std::string, int>>& files);
+
+	size_t size() const
+	{
+		return m_entries.size();
+	}
+	std::string GetName(size_t index) const;
+	int GetSize(size_t index) const;
+	//! index of the file, -1 if the archive doesn't contain it
+	int Find(const std::string& name) const;
+	bool Contains(const std::string& name) const
+	{
+		return Find(name) >= 0;
+	}
+
+	//! all files starting with prefix, "" returns all
+	StringVector FindPrefix(const std::string& prefix) const;
+	//! all files matching pattern, * matches any characters including /, ? a single one
+	StringVector FindGlob(const std::string& pattern) const;
+
+	//! heap memory of the index in bytes
+	size_t GetMemoryUsage() const;
+
+private:
+	struct Entry
+	{
+		unsigned int offset; //! into m_names
+		unsigned int length;
+		int size;
+	};
+
+	//! range of entries starting with prefix
+	void PrefixRange(const std::string& prefix, size_t& first, size_t& last) const;
+	//! case insensitive compare of the first len characters of the name of entry with str
+	int Compare(const Entry& entry, const std::string& str, size_t len) const;
+
+	std::vector<Entry> m_entries;
+	std::string m_names;
+};
+
+} // namespace LSL
+
+#endif // LSL_HEADERGUARD_ARCHIVEINDEX_H
@@ -4,6 +4,7 @@
 
 #include <stdexcept>
 #include <cmath>
+#include <algorithm>
 
 #include <lslutils/logging.h>
 #include <lslutils/misc.h>
@@ -12,6 +13,7 @@
 #include <lslutils/conversion.h>
 
 #include "image.h"
+#include "luatable.h"
 #include "loader.h"
 #include "sharedlib.h"
 
@@ -152,6 +154,12 @@ void UnitsyncLib::_Init()
 	}
 }
 
+void UnitsyncLib::ReInit()
+{
+	InitLib(m_init);
+	_Init();
+}
+
 void UnitsyncLib::_RemoveAllArchives()
 {
 	if (m_remove_all_archives)
@@ -360,10 +368,32 @@ UnitsyncLib::StringVector UnitsyncLib::GetMapDeps(int index)
 }
 
 MapInfo UnitsyncLib::GetMapInfoEx(int index, int version)
+{
+	InitLib(m_get_map_name);
+	return _GetMapInfoEx(index, version);
+}
+
+std::vector<MapInfo> UnitsyncLib::GetMapInfosEx(const std::vector<int>& indices, int version, std::vector<bool>& valid)
+{
+	InitLib(m_get_map_name);
+	std::vector<MapInfo> ret(indices.size());
+	valid.assign(indices.size(), false);
+	for (size_t i = 0; i < indices.size(); i++) {
+		try {
+			ret[i] = _GetMapInfoEx(indices[i], version);
+			valid[i] = true;
+		} catch (std::exception& e) {
+			LslWarning("Failed to get map info %d: %s", indices[i], e.what());
+		}
+	}
+	return ret;
+}
+
+MapInfo UnitsyncLib::_GetMapInfoEx(int index, int version)
 {
 	if (m_get_map_description == NULL) {
 		// old fetch method
-		InitLib(m_get_map_info_ex);
+		CHECK_FUNCTION(m_get_map_info_ex);
 
 		const std::string mapName = Util::SafeString(m_get_map_name(index));
 
@@ -382,9 +412,7 @@ MapInfo UnitsyncLib::GetMapInfoEx(int index, int version)
 		return info;
 	} else {
 		// new fetch method
-		InitLib(m_get_map_description)
-
-		    MapInfo info;
+		MapInfo info;
 		info.description = Util::SafeString(m_get_map_description(index));
 		info.tidalStrength = m_get_map_tidalStrength(index);
 		info.gravity = m_get_map_gravity(index);
@@ -467,6 +495,40 @@ UnitsyncImage UnitsyncLib::GetHeightmap(const std::string& mapFileName)
 	return img;
 }
 
+void UnitsyncLib::GetHeightmapData(const std::string& mapFileName, std::vector<unsigned short>& data, int& width, int& height)
+{
+	InitLib(m_get_infomap_size); // assume GetInfoMap is available too
+	width = height = 0;
+	int retval = m_get_infomap_size(mapFileName.c_str(), "height", &width, &height);
+	if (!(retval != 0 && width * height != 0))
+		LSL_THROWF(unitsync, "Get heightmap size failed %s", mapFileName.c_str());
+	data.resize(width * height);
+	retval = m_get_infomap(mapFileName.c_str(), "height", &data[0], 2 /*byte per pixel*/);
+	if (retval == 0)
+		LSL_THROWF(unitsync, "Get heightmap failed %s", mapFileName.c_str());
+}
+
+void UnitsyncLib::GetMetalmapData(const std::string& mapFileName, std::vector<unsigned char>& data, int& width, int& height)
+{
+	InitLib(m_get_infomap_size); // assume GetInfoMap is available too
+	width = height = 0;
+	int retval = m_get_infomap_size(mapFileName.c_str(), "metal", &width, &height);
+	if (!(retval != 0 && width * height != 0))
+		LSL_THROWF(unitsync, "Get metalmap size failed %s", mapFileName.c_str());
+	data.resize(width * height);
+	retval = m_get_infomap(mapFileName.c_str(), "metal", &data[0], 1 /*byte per pixel*/);
+	if (retval == 0)
+		LSL_THROWF(unitsync, "Get metalmap failed %s", mapFileName.c_str());
+}
+
+void UnitsyncLib::GetMapHeightRange(const std::string& mapFileName, float& minheight, float& maxheight)
+{
+	InitLib(m_get_map_min_height);
+	CHECK_FUNCTION(m_get_map_max_height);
+	minheight = m_get_map_min_height(mapFileName.c_str());
+	maxheight = m_get_map_max_height(mapFileName.c_str());
+}
+
 unsigned int UnitsyncLib::GetPrimaryModChecksum(int index)
 {
 	InitLib(m_get_mod_checksum);
@@ -837,6 +899,29 @@ int UnitsyncLib::FindFilesArchive(int archive, int cur, std::string& nameBuf)
 	return ret;
 }
 
+void UnitsyncLib::GetArchiveFiles(const std::string& archivepath, std::vector<std::pair<std::string, int>>& files)
+{
+	InitLib(m_open_archive);
+	CHECK_FUNCTION(m_find_Files_archive);
+	CHECK_FUNCTION(m_close_archive);
+	const int archive = m_open_archive(archivepath.c_str());
+	if (archive == 0)
+		LSL_THROWF(unitsync, "Couldn't open archive %s", archivepath.c_str());
+	files.clear();
+	int cur = 0;
+	while (true) {
+		char buffer[1025];
+		int size = 1024; // buffer size in, file size out
+		const int next = m_find_Files_archive(archive, cur, &buffer[0], &size);
+		if (next == 0)
+			break;
+		buffer[1024] = 0;
+		files.push_back(std::make_pair(std::string(&buffer[0]), size));
+		cur = next;
+	}
+	m_close_archive(archive);
+}
+
 int UnitsyncLib::OpenArchiveFile(int archive, const std::string& name)
 {
 	InitLib(m_open_archive_file);
@@ -1115,10 +1200,154 @@ int UnitsyncLib::ParserGetStringKeyListCount()
 	return m_parser_string_key_get_list_count();
 }
 
-int UnitsyncLib::ParserGetStringKeyListEntry(int index)
+std::string UnitsyncLib::ParserGetStringKeyListEntry(int index)
 {
-	InitLib(m_parser_int_key_get_list_entry);
-	return m_parser_int_key_get_list_entry(index);
+	InitLib(m_parser_string_key_get_list_entry);
+	return Util::SafeString(m_parser_string_key_get_list_entry(index));
+}
+
+void UnitsyncLib::_CheckParserReadFunctions()
+{
+	CHECK_FUNCTION(m_parser_int_key_get_list_count);
+	CHECK_FUNCTION(m_parser_int_key_get_list_entry);
+	CHECK_FUNCTION(m_parser_string_key_get_list_count);
+	CHECK_FUNCTION(m_parser_string_key_get_list_entry);
+	CHECK_FUNCTION(m_parser_int_key_get_type);
+	CHECK_FUNCTION(m_parser_string_key_get_type);
+	CHECK_FUNCTION(m_parser_int_key_get_bool_value);
+	CHECK_FUNCTION(m_parser_string_key_get_bool_value);
+	CHECK_FUNCTION(m_parser_int_key_get_int_value);
+	CHECK_FUNCTION(m_parser_string_key_get_int_value);
+	CHECK_FUNCTION(m_parser_int_key_get_float_value);
+	CHECK_FUNCTION(m_parser_string_key_get_float_value);
+	CHECK_FUNCTION(m_parser_int_key_get_string_value);
+	CHECK_FUNCTION(m_parser_string_key_get_string_value);
+	CHECK_FUNCTION(m_parser_sub_table_int);
+	CHECK_FUNCTION(m_parser_sub_table_string);
+	CHECK_FUNCTION(m_parser_pop_table);
+}
+
+// lua type ids as returned by lpGet*KeyType
+enum {
+	LUA_TYPE_BOOLEAN = 1,
+	LUA_TYPE_NUMBER = 3,
+	LUA_TYPE_STRING = 4,
+	LUA_TYPE_TABLE = 5
+};
+
+void UnitsyncLib::_ParserReadTable(LuaTable& table, size_t node, int depth)
+{
+	std::vector<int> intkeys(std::max(0, m_parser_int_key_get_list_count()));
+	for (size_t i = 0; i < intkeys.size(); i++) {
+		intkeys[i] = m_parser_int_key_get_list_entry(i);
+	}
+	StringVector strkeys(std::max(0, m_parser_string_key_get_list_count()));
+	for (size_t i = 0; i < strkeys.size(); i++) {
+		strkeys[i] = Util::SafeString(m_parser_string_key_get_list_entry(i));
+	}
+	// LuaTable::Value looks keys up with a binary search
+	std::sort(intkeys.begin(), intkeys.end());
+	std::sort(strkeys.begin(), strkeys.end());
+
+	// all children are allocated before descending so they stay consecutive
+	const size_t first = table.AddChildren(node, intkeys.size() + strkeys.size());
+	for (size_t i = 0; i < intkeys.size(); i++) {
+		const int key = intkeys[i];
+		const size_t child = first + i;
+		table.SetKey(child, key);
+		switch (m_parser_int_key_get_type(key)) {
+			case LUA_TYPE_BOOLEAN:
+				table.SetBool(child, m_parser_int_key_get_bool_value(key, false));
+				break;
+			case LUA_TYPE_NUMBER:
+				table.SetNumber(child, m_parser_int_key_get_int_value(key, 0), m_parser_int_key_get_float_value(key, 0.0f));
+				break;
+			case LUA_TYPE_STRING:
+				table.SetString(child, Util::SafeString(m_parser_int_key_get_string_value(key, "")));
+				break;
+			case LUA_TYPE_TABLE:
+				table.SetTable(child);
+				if ((depth > 0) && m_parser_sub_table_int(key)) {
+					_ParserReadTable(table, child, depth - 1);
+					m_parser_pop_table();
+				}
+				break;
+			default:
+				break;
+		}
+	}
+	for (size_t i = 0; i < strkeys.size(); i++) {
+		const char* key = strkeys[i].c_str();
+		const size_t child = first + intkeys.size() + i;
+		table.SetKey(child, strkeys[i]);
+		switch (m_parser_string_key_get_type(key)) {
+			case LUA_TYPE_BOOLEAN:
+				table.SetBool(child, m_parser_string_key_get_bool_value(key, false));
+				break;
+			case LUA_TYPE_NUMBER:
+				table.SetNumber(child, m_parser_string_key_get_int_value(key, 0), m_parser_string_key_get_float_value(key, 0.0f));
+				break;
+			case LUA_TYPE_STRING:
+				table.SetString(child, Util::SafeString(m_parser_string_key_get_string_value(key, "")));
+				break;
+			case LUA_TYPE_TABLE:
+				table.SetTable(child);
+				if ((depth > 0) && m_parser_sub_table_string(key)) {
+					_ParserReadTable(table, child, depth - 1);
+					m_parser_pop_table();
+				}
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+bool UnitsyncLib::ParserGetTable(LuaTable& table, int maxdepth)
+{
+	InitLib(m_parser_int_key_get_list_count);
+	_CheckParserReadFunctions();
+	table.Clear();
+	_ParserReadTable(table, 0, maxdepth);
+	return true;
+}
+
+bool UnitsyncLib::ParseLuaFile(const std::string& filename, const std::string& filemodes, const std::string& accessModes, LuaTable& table, std::string* errorlog)
+{
+	InitLib(m_parser_open_file);
+	CHECK_FUNCTION(m_parser_execute);
+	CHECK_FUNCTION(m_parser_root_table);
+	CHECK_FUNCTION(m_parser_error_log);
+	CHECK_FUNCTION(m_parser_close);
+	_CheckParserReadFunctions();
+	table.Clear();
+	const bool ok = m_parser_open_file(filename.c_str(), filemodes.c_str(), accessModes.c_str()) && m_parser_execute() && m_parser_root_table();
+	if (ok) {
+		_ParserReadTable(table, 0, 16);
+	} else if (errorlog != NULL) {
+		*errorlog = Util::SafeString(m_parser_error_log());
+	}
+	m_parser_close();
+	return ok;
+}
+
+bool UnitsyncLib::ParseLuaSource(const std::string& source, const std::string& accessModes, LuaTable& table, std::string* errorlog)
+{
+	InitLib(m_parser_open_source);
+	CHECK_FUNCTION(m_parser_execute);
+	CHECK_FUNCTION(m_parser_root_table);
+	CHECK_FUNCTION(m_parser_error_log);
+	CHECK_FUNCTION(m_parser_close);
+	_CheckParserReadFunctions();
+	table.Clear();
+	const bool ok = m_parser_open_source(source.c_str(), accessModes.c_str()) && m_parser_execute() && m_parser_root_table();
+	if (ok) {
+		_ParserReadTable(table, 0, 16);
+	} else if (errorlog != NULL) {
+		*errorlog = Util::SafeString(m_parser_error_log());
+	}
+	m_parser_close();
+	return ok;
 }
 
 int UnitsyncLib::GetKeyValue(int key, int defval)
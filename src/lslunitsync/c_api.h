@@ -16,6 +16,7 @@ namespace LSL
 {
 
 class UnitsyncImage;
+class LuaTable;
 struct UnitsyncFunctionLoader;
 
 static const unsigned int MapInfoMaxStartPositions = 16;
@@ -103,6 +104,12 @@ public:
 	 */
 	void Unload();
 
+	/**
+	 * Initializes the loaded library again, which rescans the archives in
+	 * the data dirs. Unitsync keeps checksums of unchanged archives cached.
+	 */
+	void ReInit();
+
 	/**
 	 * Returns true if the library is loaded.
 	 */
@@ -142,6 +149,12 @@ public:
 	 */
 	MapInfo GetMapInfoEx(int index, int version);
 
+	/**
+	 * @brief GetMapInfoEx() for many maps, unitsync is locked only once.
+	 * @param valid is set to false for the maps which failed, their MapInfo is empty.
+	 */
+	std::vector<MapInfo> GetMapInfosEx(const std::vector<int>& indices, int version, std::vector<bool>& valid);
+
 	/**
 	 * @brief Get minimap.
 	 * @note Throws assert_exception if unsuccessful.
@@ -160,6 +173,24 @@ public:
 	 */
 	UnitsyncImage GetHeightmap(const std::string& mapFileName);
 
+	/**
+	 * @brief Get the unscaled 16 bit height infomap.
+	 * @note Throws assert_exception if unsuccesful.
+	 */
+	void GetHeightmapData(const std::string& mapFileName, std::vector<unsigned short>& data, int& width, int& height);
+
+	/**
+	 * @brief Get the unscaled 8 bit metal infomap.
+	 * @note Throws assert_exception if unsuccesful.
+	 */
+	void GetMetalmapData(const std::string& mapFileName, std::vector<unsigned char>& data, int& width, int& height);
+
+	/**
+	 * @brief Get the lowest and highest point of the map, the height infomap is scaled to it.
+	 * @note Throws function_missing with unitsync older than 0.82.
+	 */
+	void GetMapHeightRange(const std::string& mapFileName, float& minheight, float& maxheight);
+
 	unsigned int GetPrimaryModChecksum(int index);
 	int GetPrimaryModIndex(const std::string& modName);
 	std::string GetPrimaryModName(int index);
@@ -238,6 +269,8 @@ public:
 	void CloseArchiveFile(int archive, int handle);
 	int SizeArchiveFile(int archive, int handle);
 	std::string GetArchivePath(const std::string& name);
+	//! name and size of all files of the archive, enumerated while unitsync is locked once
+	void GetArchiveFiles(const std::string& archivepath, std::vector<std::pair<std::string, int>>& files);
 
 	int GetSpringConfigInt(const std::string& key, int defValue);
 	std::string GetSpringConfigString(const std::string& key, const std::string& defValue);
@@ -293,7 +326,17 @@ public:
 	int ParserGetIntKeyListCount();
 	int ParserGetIntKeyListEntry(int index);
 	int ParserGetStringKeyListCount();
-	int ParserGetStringKeyListEntry(int index);
+	std::string ParserGetStringKeyListEntry(int index);
+
+	/** @brief copies the current parser table with all sub tables into table,
+	 *  holding the unitsync lock once instead of once per key.
+	 *  Tables nested deeper than maxdepth are stored empty. */
+	bool ParserGetTable(LuaTable& table, int maxdepth = 16);
+	/** @brief opens, executes and reads the root table of a lua file / source
+	 *  and closes the parser again, all under one lock.
+	 *  On failure the parser error log is returned in errorlog if given. */
+	bool ParseLuaFile(const std::string& filename, const std::string& filemodes, const std::string& accessModes, LuaTable& table, std::string* errorlog = NULL);
+	bool ParseLuaSource(const std::string& source, const std::string& accessModes, LuaTable& table, std::string* errorlog = NULL);
 
 	int GetKeyValue(int key, int defval);
 	bool GetKeyValue(int key, bool defval);
@@ -343,6 +386,14 @@ private:
 	 */
 	void _Init();
 
+	//! reads the current parser table into node of table, unitsync must be locked
+	void _ParserReadTable(LuaTable& table, size_t node, int depth);
+	//! checks all functions used by _ParserReadTable are loaded
+	void _CheckParserReadFunctions();
+
+	//! GetMapInfoEx() without locking, unitsync must be locked
+	MapInfo _GetMapInfoEx(int index, int version);
+
 	/**
 	 * Calls RemoveAllArchives if available, _Init() otherwise.
 	 */
@@ -399,6 +450,8 @@ private:
 	GetMinimapPtr m_get_minimap;
 	GetInfoMapSizePtr m_get_infomap_size;
 	GetInfoMapPtr m_get_infomap;
+	GetMapMinHeightPtr m_get_map_min_height;
+	GetMapMaxHeightPtr m_get_map_max_height;
 
 	GetPrimaryModChecksumPtr m_get_mod_checksum;
 	GetPrimaryModIndexPtr m_get_mod_index;
@@ -47,6 +47,13 @@ struct MapInfo
 	std::vector<StartPos> positions;
 
 	std::string author;
+
+	//! heap memory of the strings and positions
+	size_t GetMemoryUsage() const
+	{
+		return description.capacity() + author.capacity() + positions.capacity() * sizeof(StartPos);
+	}
+
 	MapInfo()
 	    : description("")
 	    , tidalStrength(0)
@@ -62,6 +69,44 @@ struct MapInfo
 	}
 };
 
+//! the fixed size fields of MapInfo, all map list views need
+struct MapSummary
+{
+	MapSummary()
+	    : tidalStrength(0)
+	    , gravity(0)
+	    , maxMetal(0.0f)
+	    , extractorRadius(0)
+	    , minWind(0)
+	    , maxWind(0)
+	    , width(0)
+	    , height(0)
+	    , positionCount(0)
+	{
+	}
+	explicit MapSummary(const MapInfo& info)
+	    : tidalStrength(info.tidalStrength)
+	    , gravity(info.gravity)
+	    , maxMetal(info.maxMetal)
+	    , extractorRadius(info.extractorRadius)
+	    , minWind(info.minWind)
+	    , maxWind(info.maxWind)
+	    , width(info.width)
+	    , height(info.height)
+	    , positionCount(info.positions.size())
+	{
+	}
+	int tidalStrength;
+	int gravity;
+	float maxMetal;
+	int extractorRadius;
+	int minWind;
+	int maxWind;
+	int width;
+	int height;
+	int positionCount;
+};
+
 struct UnitsyncMap
 {
 	UnitsyncMap()
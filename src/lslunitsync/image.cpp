@@ -181,6 +181,21 @@ UnitsyncImage UnitsyncImage::FromMetalmapData(const Util::uninitialized_array<un
 	return UnitsyncImage(ptr);
 }
 
+UnitsyncImage UnitsyncImage::FromRGBData(const unsigned char* rgb, int width, int height)
+{
+	PrivateImageType* img_p = NewImagePtr(width, height);
+	PrivateImageType& img = *img_p;
+	cimg_forXY(img, x, y)
+	{
+		const unsigned char* pixel = rgb + 3 * (x + (y * width));
+		img(x, y, 0, 0) = pixel[0];
+		img(x, y, 0, 1) = pixel[1];
+		img(x, y, 0, 2) = pixel[2];
+	}
+	PrivateImageType* ptr(img_p);
+	return UnitsyncImage(ptr);
+}
+
 UnitsyncImage UnitsyncImage::FromVfsFileData(Util::uninitialized_array<char>& data, size_t size,
 					     const std::string& fn, bool useWhiteAsTransparent)
 {
@@ -202,19 +217,29 @@ UnitsyncImage::UnitsyncImage()
 {
 }
 
-void UnitsyncImage::Save(const std::string& path) const
+bool UnitsyncImage::Save(const std::string& path) const
 {
 	if (!isValid()) {
 		LslError("%s:%d (%s) %s failed, invalid image", __FILE__, __LINE__, __FUNCTION__, path.c_str());
-		return;
+		return false;
 	}
 	FILE* f = Util::lslopen(path, "wb+");
 	if (f == NULL) {
 		LslError("%s:%d (%s) error creating file %s", __FILE__, __LINE__, __FUNCTION__, path.c_str());
-		return;
+		return false;
 	}
-	m_data_ptr->save_png(f);
-	fclose(f);
+	try {
+		m_data_ptr->save_png(f);
+	} catch (cimg_library::CImgException& c) {
+		LslError("%s:%d (%s) %s failed: %s", __FILE__, __LINE__, __FUNCTION__, path.c_str(), c.what());
+		fclose(f);
+		return false;
+	}
+	if (fclose(f) != 0) {
+		LslError("%s:%d (%s) error writing file %s", __FILE__, __LINE__, __FUNCTION__, path.c_str());
+		return false;
+	}
+	return true;
 }
 
 void UnitsyncImage::Load(const std::string& path) const
@@ -348,6 +373,70 @@ int UnitsyncImage::GetWidth() const
 	return m_data_ptr->width();
 }
 
+//! expands gray / rgb images to rgba, missing alpha is opaque
+template <class T>
+static void ToRGBA(cimg_library::CImg<T>& img)
+{
+	if (img.spectrum() == 4)
+		return;
+	cimg_library::CImg<T> rgba(img.width(), img.height(), 1, 4);
+	cimg_forXY(img, x, y)
+	{
+		const bool gray = img.spectrum() < 3;
+		rgba(x, y, 0, 0) = img(x, y, 0, 0);
+		rgba(x, y, 0, 1) = gray ? img(x, y, 0, 0) : img(x, y, 0, 1);
+		rgba(x, y, 0, 2) = gray ? img(x, y, 0, 0) : img(x, y, 0, 2);
+		rgba(x, y, 0, 3) = (img.spectrum() == 2) ? img(x, y, 0, 1) : 255;
+	}
+	img.swap(rgba);
+}
+
+void UnitsyncImage::Paste(const UnitsyncImage& src, int x, int y)
+{
+	if (!isValid() || !src.isValid()) {
+		LslError("%s:%d (%s) failed, invalid image", __FILE__, __LINE__, __FUNCTION__);
+		return;
+	}
+	ToRGBA(*m_data_ptr);
+	PrivateImageType rgba(*src.m_data_ptr);
+	ToRGBA(rgba);
+	m_data_ptr->draw_image(x, y, 0, 0, rgba);
+}
+
+UnitsyncImage UnitsyncImage::Crop(int x, int y, int width, int height) const
+{
+	UnitsyncImage ret;
+	if (!isValid() || width <= 0 || height <= 0) {
+		LslError("%s:%d (%s) failed, invalid image", __FILE__, __LINE__, __FUNCTION__);
+		return ret;
+	}
+	*ret.m_data_ptr = m_data_ptr->get_crop(x, y, x + width - 1, y + height - 1);
+	return ret;
+}
+
+std::vector<unsigned char> UnitsyncImage::GetRGBData() const
+{
+	std::vector<unsigned char> ret;
+	if (!isValid())
+		return ret;
+	const PrivateImageType& img = *m_data_ptr;
+	const bool gray = img.spectrum() < 3;
+	ret.resize(3 * img.width() * img.height());
+	cimg_forXY(img, x, y)
+	{
+		unsigned char* pixel = &ret[3 * (x + (y * img.width()))];
+		pixel[0] = img(x, y, 0, 0);
+		pixel[1] = gray ? img(x, y, 0, 0) : img(x, y, 0, 1);
+		pixel[2] = gray ? img(x, y, 0, 0) : img(x, y, 0, 2);
+	}
+	return ret;
+}
+
+size_t UnitsyncImage::GetMemoryUsage() const
+{
+	return m_data_ptr->size() * sizeof(RawDataType);
+}
+
 void UnitsyncImage::RescaleIfBigger(const int maxwidth, const int maxheight)
 {
 	if (!isValid())
@@ -4,6 +4,7 @@
 #define LSL_IMAGE_H
 
 #include <string>
+#include <vector>
 
 //we really, really don't want to include the cimg
 // header here, it's 2.1MB of template magic :)
@@ -44,8 +45,8 @@ public:
 	UnitsyncImage(int width, int height);
 	UnitsyncImage(const std::string& filename);
 
-	//! delegates save to cimg library, format is deducted from last path compoment (ie. after the last dot)
-	void Save(const std::string& path) const;
+	//! delegates save to cimg library, format is deducted from last path compoment (ie. after the last dot), false on failure
+	bool Save(const std::string& path) const;
 	//! same principle as \ref Save
 	void Load(const std::string& path) const;
 
@@ -57,6 +58,8 @@ public:
 	static UnitsyncImage FromHeightmapData(const Util::uninitialized_array<unsigned short>& data, int width, int height);
 	static UnitsyncImage FromMetalmapData(const Util::uninitialized_array<unsigned char>& data, int width, int height);
 	static UnitsyncImage FromVfsFileData(Util::uninitialized_array<char>& data, size_t size, const std::string& fn, bool useWhiteAsTransparent = true);
+	//! rgb has 3 bytes per pixel, row by row
+	static UnitsyncImage FromRGBData(const unsigned char* rgb, int width, int height);
 ///@}
 
 #ifdef HAVE_WX
@@ -65,6 +68,8 @@ public:
 #endif
 	int GetWidth() const;
 	int GetHeight() const;
+	//! bytes used by the pixel data
+	size_t GetMemoryUsage() const;
 	void Rescale(const int new_width, const int new_height);
 	//rescale image to a max resolution 512x512 with keeping aspect ratio
 	void RescaleIfBigger(const int maxwidth = 512, const int maxheight = 512);
@@ -75,6 +80,12 @@ public:
 	}
 	// makes given color transparent
 	void MakeTransparent(unsigned short r = 255, unsigned short g = 255, unsigned short b = 255);
+	//! draws src with its top left corner at x,y, converts this image to rgba
+	void Paste(const UnitsyncImage& src, int x, int y);
+	//! copy of the width x height rectangle at x,y
+	UnitsyncImage Crop(int x, int y, int width, int height) const;
+	//! 3 bytes per pixel row by row, gray images are expanded and alpha is dropped
+	std::vector<unsigned char> GetRGBData() const;
 
 private:
 	UnitsyncImage(PrivateImageType* ptr);
@@ -118,6 +118,8 @@ void UnitsyncFunctionLoader::Map(UnitsyncLib* s)
 	BIND(GetMinimapPtr, "GetMinimap", m_get_minimap);
 	BIND(GetInfoMapSizePtr, "GetInfoMapSize", m_get_infomap_size);
 	BIND(GetInfoMapPtr, "GetInfoMap", m_get_infomap);
+	BIND(GetMapMinHeightPtr, "GetMapMinHeight", m_get_map_min_height);
+	BIND(GetMapMaxHeightPtr, "GetMapMaxHeight", m_get_map_max_height);
 
 	BIND(GetMapArchiveCountPtr, "GetMapArchiveCount", m_get_map_archive_count);
 	BIND(GetMapArchiveNamePtr, "GetMapArchiveName", m_get_map_archive_name);
@@ -0,0 +1,225 @@
+/* This file is part of the Springlobby (GPL v2 or later), see COPYING */
+
+#include "luatable.h"
+
+#include <cstring>
+
+namespace LSL
+{
+
+LuaTable::LuaTable()
+{
+	Clear();
+}
+
+void LuaTable::Clear()
+{
+	m_nodes.clear();
+	m_strings.clear();
+	Node root;
+	memset(&root, 0, sizeof(root));
+	root.type = TYPE_TABLE;
+	m_nodes.push_back(root);
+}
+
+size_t LuaTable::AddChildren(size_t parent, size_t count)
+{
+	const size_t first = m_nodes.size();
+	Node node;
+	memset(&node, 0, sizeof(node));
+	node.type = TYPE_NIL;
+	m_nodes.resize(first + count, node);
+	m_nodes[parent].first = first;
+	m_nodes[parent].count = count;
+	return first;
+}
+
+unsigned int LuaTable::AddString(const std::string& str)
+{
+	const unsigned int offset = m_strings.size();
+	m_strings.append(str);
+	return offset;
+}
+
+void LuaTable::SetKey(size_t node, int key)
+{
+	m_nodes[node].stringkey = false;
+	m_nodes[node].intkey = key;
+	m_nodes[node].keylen = 0;
+}
+
+void LuaTable::SetKey(size_t node, const std::string& key)
+{
+	m_nodes[node].stringkey = true;
+	m_nodes[node].intkey = AddString(key);
+	m_nodes[node].keylen = key.size();
+}
+
+void LuaTable::SetBool(size_t node, bool val)
+{
+	m_nodes[node].type = TYPE_BOOL;
+	m_nodes[node].boolean = val;
+}
+
+void LuaTable::SetNumber(size_t node, int integer, float number)
+{
+	m_nodes[node].type = TYPE_NUMBER;
+	m_nodes[node].integer = integer;
+	m_nodes[node].number = number;
+}
+
+void LuaTable::SetString(size_t node, const std::string& val)
+{
+	m_nodes[node].type = TYPE_STRING;
+	m_nodes[node].str = AddString(val);
+	m_nodes[node].strlen = val.size();
+}
+
+void LuaTable::SetTable(size_t node)
+{
+	m_nodes[node].type = TYPE_TABLE;
+}
+
+LuaTable::Value LuaTable::Root() const
+{
+	return Value(this, 0);
+}
+
+size_t LuaTable::GetMemoryUsage() const
+{
+	return sizeof(*this) + m_nodes.capacity() * sizeof(Node) + m_strings.capacity();
+}
+
+LuaTable::Type LuaTable::Value::GetType() const
+{
+	if (m_table == NULL)
+		return TYPE_NIL;
+	return m_table->m_nodes[m_index].type;
+}
+
+bool LuaTable::Value::GetBool(bool defval) const
+{
+	switch (GetType()) {
+		case TYPE_BOOL:
+			return m_table->m_nodes[m_index].boolean;
+		case TYPE_NUMBER:
+			return m_table->m_nodes[m_index].number != 0.0f;
+		default:
+			return defval;
+	}
+}
+
+int LuaTable::Value::GetInt(int defval) const
+{
+	switch (GetType()) {
+		case TYPE_NUMBER:
+			return m_table->m_nodes[m_index].integer;
+		case TYPE_BOOL:
+			return m_table->m_nodes[m_index].boolean ? 1 : 0;
+		default:
+			return defval;
+	}
+}
+
+float LuaTable::Value::GetFloat(float defval) const
+{
+	switch (GetType()) {
+		case TYPE_NUMBER:
+			return m_table->m_nodes[m_index].number;
+		case TYPE_BOOL:
+			return m_table->m_nodes[m_index].boolean ? 1.0f : 0.0f;
+		default:
+			return defval;
+	}
+}
+
+std::string LuaTable::Value::GetString(const std::string& defval) const
+{
+	if (GetType() != TYPE_STRING)
+		return defval;
+	const Node& node = m_table->m_nodes[m_index];
+	return m_table->GetString(node.str, node.strlen);
+}
+
+bool LuaTable::Value::HasStringKey() const
+{
+	if ((m_table == NULL) || (m_index == 0))
+		return false;
+	return m_table->m_nodes[m_index].stringkey;
+}
+
+int LuaTable::Value::GetIntKey() const
+{
+	if ((m_table == NULL) || (m_index == 0) || HasStringKey())
+		return 0;
+	return m_table->m_nodes[m_index].intkey;
+}
+
+std::string LuaTable::Value::GetStringKey() const
+{
+	if (!HasStringKey())
+		return "";
+	const Node& node = m_table->m_nodes[m_index];
+	return m_table->GetString(node.intkey, node.keylen);
+}
+
+size_t LuaTable::Value::size() const
+{
+	if (!IsTable())
+		return 0;
+	return m_table->m_nodes[m_index].count;
+}
+
+LuaTable::Value LuaTable::Value::GetChild(size_t index) const
+{
+	if (index >= size())
+		return Value();
+	return Value(m_table, m_table->m_nodes[m_index].first + index);
+}
+
+LuaTable::Value LuaTable::Value::operator[](int key) const
+{
+	if (!IsTable())
+		return Value();
+	const Node& parent = m_table->m_nodes[m_index];
+	// integer keys are sorted ascending in front of the string keys
+	size_t lo = parent.first;
+	size_t hi = parent.first + parent.count;
+	while (lo < hi) {
+		const size_t mid = lo + (hi - lo) / 2;
+		const Node& node = m_table->m_nodes[mid];
+		if (node.stringkey || node.intkey > key) {
+			hi = mid;
+		} else if (node.intkey < key) {
+			lo = mid + 1;
+		} else {
+			return Value(m_table, mid);
+		}
+	}
+	return Value();
+}
+
+LuaTable::Value LuaTable::Value::operator[](const std::string& key) const
+{
+	if (!IsTable())
+		return Value();
+	const Node& parent = m_table->m_nodes[m_index];
+	size_t lo = parent.first;
+	size_t hi = parent.first + parent.count;
+	while (lo < hi) {
+		const size_t mid = lo + (hi - lo) / 2;
+		const Node& node = m_table->m_nodes[mid];
+		// string keys are behind all integer keys
+		const int cmp = node.stringkey ? m_table->m_strings.compare(node.intkey, node.keylen, key) : -1;
+		if (cmp > 0) {
+			hi = mid;
+		} else if (cmp < 0) {
+			lo = mid + 1;
+		} else {
+			return Value(m_table, mid);
+		}
+	}
+	return Value();
+}
+
+} // namespace LSL
@@ -0,0 +1,132 @@
+/* This file is part of the Springlobby (GPL v2 or later), see COPYING */
+
+#ifndef LSL_HEADERGUARD_LUATABLE_H
+#define LSL_HEADERGUARD_LUATABLE_H
+
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+
+namespace LSL
+{
+
+class UnitsyncLib;
+
+/** \brief copy of a lua table read from the unitsync lua parser
+ *
+ * UnitsyncLib::ParserGetTable() walks a whole table under one unitsync lock
+ * and stores it here, queries don't touch unitsync. All nodes live in one
+ * array and all strings in one buffer, the children of a table are stored
+ * next to each other: integer keys ascending, then string keys sorted.
+ */
+class LuaTable : public boost::noncopyable
+{
+public:
+	//! lua types, everything else (functions, userdata) is stored as nil
+	enum Type {
+		TYPE_NIL,
+		TYPE_BOOL,
+		TYPE_NUMBER,
+		TYPE_STRING,
+		TYPE_TABLE
+	};
+
+	//! handle of a node, only valid as long as the LuaTable isn't changed
+	class Value
+	{
+	public:
+		Value()
+		    : m_table(NULL)
+		    , m_index(0)
+		{
+		}
+		Type GetType() const;
+		bool IsNil() const
+		{
+			return GetType() == TYPE_NIL;
+		}
+		bool IsTable() const
+		{
+			return GetType() == TYPE_TABLE;
+		}
+
+		bool GetBool(bool defval = false) const;
+		int GetInt(int defval = 0) const;
+		float GetFloat(float defval = 0.0f) const;
+		std::string GetString(const std::string& defval = "") const;
+
+		//! key of this node in its parent table
+		bool HasStringKey() const;
+		int GetIntKey() const;
+		std::string GetStringKey() const;
+
+		//! number of children of a table
+		size_t size() const;
+		Value GetChild(size_t index) const;
+		//! child with the key, nil if there is none
+		Value operator[](int key) const;
+		Value operator[](const std::string& key) const;
+
+	private:
+		friend class LuaTable;
+		Value(const LuaTable* table, size_t index)
+		    : m_table(table)
+		    , m_index(index)
+		{
+		}
+		const LuaTable* m_table;
+		size_t m_index;
+	};
+
+	LuaTable();
+
+	Value Root() const;
+	//! all nodes including the root
+	size_t GetNodeCount() const
+	{
+		return m_nodes.size();
+	}
+	size_t GetMemoryUsage() const;
+
+private:
+	friend class UnitsyncLib;
+
+	struct Node
+	{
+		Type type;
+		bool stringkey;
+		bool boolean;
+		int intkey;	//! or offset of the string key in m_strings
+		unsigned int keylen;
+		int integer;
+		float number;
+		unsigned int str; //! offset of the string value in m_strings
+		unsigned int strlen;
+		unsigned int first; //! index of the first child
+		unsigned int count;
+	};
+
+	// used by UnitsyncLib while walking the parser tables
+	void Clear();
+	//! reserves count consecutive child nodes of parent, returns the index of the first
+	size_t AddChildren(size_t parent, size_t count);
+	void SetKey(size_t node, int key);
+	void SetKey(size_t node, const std::string& key);
+	void SetBool(size_t node, bool val);
+	void SetNumber(size_t node, int integer, float number);
+	void SetString(size_t node, const std::string& val);
+	void SetTable(size_t node);
+
+	unsigned int AddString(const std::string& str);
+	std::string GetString(unsigned int offset, unsigned int len) const
+	{
+		return m_strings.substr(offset, len);
+	}
+
+	std::vector<Node> m_nodes;
+	std::string m_strings;
+};
+
+} // namespace LSL
+
+#endif // LSL_HEADERGUARD_LUATABLE_H
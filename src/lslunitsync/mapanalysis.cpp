@@ -0,0 +1,231 @@
+/* This file is part of the Springlobby (GPL v2 or later), see COPYING */
+
+#include "mapanalysis.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LSL_MAPANALYSIS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace LSL
+{
+
+void ThresholdMask(const unsigned char* values, unsigned char* mask, size_t count, unsigned char threshold)
+{
+	size_t i = 0;
+	if (threshold == 0xFF) { // nothing is above
+		for (; i < count; i++)
+			mask[i] = 0;
+		return;
+	}
+#ifdef LSL_MAPANALYSIS_SSE2
+	// there is no unsigned byte compare, v > t is max(v, t + 1) == v
+	const __m128i limit = _mm_set1_epi8((char)(threshold + 1));
+	for (; i + 16 <= count; i += 16) {
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(mask + i), _mm_cmpeq_epi8(_mm_max_epu8(v, limit), v));
+	}
+#endif
+	for (; i < count; i++) {
+		mask[i] = (values[i] > threshold) ? 0xFF : 0;
+	}
+}
+
+unsigned char MetalSpotThreshold(const unsigned char* metal, size_t count)
+{
+	if (metal == NULL || count == 0)
+		return 0xFF;
+	size_t i = 0;
+	unsigned char peak = 0;
+#ifdef LSL_MAPANALYSIS_SSE2
+	__m128i peaks = _mm_setzero_si128();
+	for (; i + 16 <= count; i += 16) {
+		peaks = _mm_max_epu8(peaks, _mm_loadu_si128(reinterpret_cast<const __m128i*>(metal + i)));
+	}
+	unsigned char lanes[16];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), peaks);
+	for (int lane = 0; lane < 16; lane++)
+		peak = std::max(peak, lanes[lane]);
+#endif
+	for (; i < count; i++)
+		peak = std::max(peak, metal[i]);
+	if (peak == 0)
+		return 0xFF;
+	// a peak of 1 still needs a pixel above the threshold
+	const unsigned char threshold = std::min<int>(peak - 1, int(peak * METAL_SPOT_PEAK_FRACTION));
+	size_t above = 0;
+	for (i = 0; i < count; i++) {
+		if (metal[i] > threshold)
+			above++;
+	}
+	if (above > count * METAL_MAP_COVERAGE)
+		return 0xFF;
+	return threshold;
+}
+
+std::vector<MetalSpot> FindMetalSpots(const unsigned char* metal, int width, int height, unsigned char threshold, float scale, float maxMetal)
+{
+	std::vector<MetalSpot> spots;
+	if (metal == NULL || width <= 0 || height <= 0)
+		return spots;
+	const size_t count = (size_t)width * height;
+	std::vector<unsigned char> mask(count);
+	ThresholdMask(metal, &mask[0], count, threshold);
+
+	// flood fill each component, visited pixels are cleared in the mask
+	std::vector<size_t> stack;
+	for (size_t start = 0; start < count; start++) {
+		if (mask[start] == 0)
+			continue;
+		mask[start] = 0;
+		stack.push_back(start);
+		double sum = 0.0;
+		double sumx = 0.0;
+		double sumy = 0.0;
+		int pixels = 0;
+		while (!stack.empty()) {
+			const size_t i = stack.back();
+			stack.pop_back();
+			const int x = i % width;
+			const int y = i / width;
+			const double value = metal[i];
+			sum += value;
+			sumx += value * x;
+			sumy += value * y;
+			pixels++;
+			for (int ny = std::max(0, y - 1); ny <= y + 1 && ny < height; ny++) {
+				for (int nx = std::max(0, x - 1); nx <= x + 1 && nx < width; nx++) {
+					const size_t n = (size_t)ny * width + nx;
+					if (mask[n] != 0) {
+						mask[n] = 0;
+						stack.push_back(n);
+					}
+				}
+			}
+		}
+		MetalSpot spot;
+		// + 0.5: centre of the pixel
+		spot.x = (sumx / sum + 0.5) * scale;
+		spot.z = (sumy / sum + 0.5) * scale;
+		spot.metal = sum / 255.0 * maxMetal;
+		spot.pixels = pixels;
+		spots.push_back(spot);
+	}
+	return spots;
+}
+
+//! slope of a single pixel, used at the borders
+static float PixelSlope(const unsigned short* heights, int width, int height, int x, int y, float dxscale, float dyscale)
+{
+	const int x0 = std::max(0, x - 1);
+	const int x1 = std::min(width - 1, x + 1);
+	const int y0 = std::max(0, y - 1);
+	const int y1 = std::min(height - 1, y + 1);
+	const float dx = (x1 > x0) ? (float(heights[y * width + x1]) - heights[y * width + x0]) * dxscale / (x1 - x0) : 0.0f;
+	const float dy = (y1 > y0) ? (float(heights[y1 * width + x]) - heights[y0 * width + x]) * dyscale / (y1 - y0) : 0.0f;
+	return std::sqrt(dx * dx + dy * dy);
+}
+
+void ComputeSlopes(const unsigned short* heights, int width, int height, float minHeight, float maxHeight, float scale, float* slopes)
+{
+	if (heights == NULL || width <= 0 || height <= 0)
+		return;
+	// height difference per unit of the infomap over map units
+	const float unit = (maxHeight - minHeight) / 65535.0f / scale;
+	for (int y = 0; y < height; y++) {
+		float* out = slopes + (size_t)y * width;
+		if (y == 0 || y == height - 1 || width < 3) {
+			for (int x = 0; x < width; x++)
+				out[x] = PixelSlope(heights, width, height, x, y, unit, unit);
+			continue;
+		}
+		const unsigned short* row = heights + (size_t)y * width;
+		const unsigned short* above = row - width;
+		const unsigned short* below = row + width;
+		out[0] = PixelSlope(heights, width, height, 0, y, unit, unit);
+		int x = 1;
+#ifdef LSL_MAPANALYSIS_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128 half = _mm_set1_ps(0.5f * unit);
+		// 4 pixels at once, the stencil reads x - 1 .. x + 4
+		for (; x + 4 < width; x += 4) {
+			const __m128 left = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + x - 1)), zero));
+			const __m128 right = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + x + 1)), zero));
+			const __m128 up = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(above + x)), zero));
+			const __m128 down = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(below + x)), zero));
+			const __m128 dx = _mm_mul_ps(_mm_sub_ps(right, left), half);
+			const __m128 dy = _mm_mul_ps(_mm_sub_ps(down, up), half);
+			_mm_storeu_ps(out + x, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy))));
+		}
+#endif
+		for (; x < width - 1; x++) {
+			const float dx = (float(row[x + 1]) - row[x - 1]) * 0.5f * unit;
+			const float dy = (float(below[x]) - above[x]) * 0.5f * unit;
+			out[x] = std::sqrt(dx * dx + dy * dy);
+		}
+		out[width - 1] = PixelSlope(heights, width, height, width - 1, y, unit, unit);
+	}
+}
+
+//! lowest infomap value above the water level
+static int WaterLine(float minHeight, float maxHeight)
+{
+	if (minHeight >= 0.0f)
+		return 0;
+	if (maxHeight <= 0.0f)
+		return 65536;
+	return (int)std::ceil(-minHeight / (maxHeight - minHeight) * 65535.0f);
+}
+
+void ClassifyTerrain(const unsigned short* heights, const float* slopes, int width, int height, float minHeight, float maxHeight, unsigned char* classes)
+{
+	const int waterline = WaterLine(minHeight, maxHeight);
+	const size_t count = (size_t)width * height;
+	for (size_t i = 0; i < count; i++) {
+		if (heights[i] < waterline) {
+			classes[i] = TERRAIN_WATER;
+		} else if (slopes[i] < TERRAIN_HILL_SLOPE) {
+			classes[i] = TERRAIN_FLAT;
+		} else if (slopes[i] < TERRAIN_CLIFF_SLOPE) {
+			classes[i] = TERRAIN_HILL;
+		} else {
+			classes[i] = TERRAIN_CLIFF;
+		}
+	}
+}
+
+TerrainStats ComputeTerrainStats(const unsigned short* heights, int width, int height, float minHeight, float maxHeight, float scale)
+{
+	TerrainStats stats;
+	if (heights == NULL || width <= 0 || height <= 0 || scale <= 0.0f)
+		return stats;
+	const size_t count = (size_t)width * height;
+	std::vector<float> slopes(count);
+	std::vector<unsigned char> classes(count);
+	ComputeSlopes(heights, width, height, minHeight, maxHeight, scale, &slopes[0]);
+	ClassifyTerrain(heights, &slopes[0], width, height, minHeight, maxHeight, &classes[0]);
+
+	size_t perclass[TERRAIN_CLASS_COUNT] = {0};
+	double slopesum = 0.0;
+	for (size_t i = 0; i < count; i++) {
+		perclass[classes[i]]++;
+		if (classes[i] != TERRAIN_WATER) {
+			slopesum += slopes[i];
+			stats.maxSlope = std::max(stats.maxSlope, slopes[i]);
+		}
+	}
+	const size_t land = count - perclass[TERRAIN_WATER];
+	stats.valid = true;
+	stats.minHeight = minHeight;
+	stats.maxHeight = maxHeight;
+	stats.meanSlope = (land > 0) ? slopesum / land : 0.0f;
+	stats.waterFraction = double(perclass[TERRAIN_WATER]) / count;
+	stats.flatFraction = double(perclass[TERRAIN_FLAT]) / count;
+	stats.passableFraction = double(perclass[TERRAIN_FLAT] + perclass[TERRAIN_HILL]) / count;
+	return stats;
+}
+
+} // namespace LSL
@@ -0,0 +1,105 @@
+/* This file is part of the Springlobby (GPL v2 or later), see COPYING */
+
+#ifndef LSL_HEADERGUARD_MAPANALYSIS_H
+#define LSL_HEADERGUARD_MAPANALYSIS_H
+
+#include <stddef.h>
+#include <vector>
+
+namespace LSL
+{
+
+//! a cluster of connected metal pixels of the metal infomap
+struct MetalSpot
+{
+	MetalSpot()
+	    : x(0.0f)
+	    , z(0.0f)
+	    , metal(0.0f)
+	    , pixels(0)
+	{
+	}
+	//! metal weighted centroid in map units (elmos)
+	float x;
+	float z;
+	//! sum of the metal of all pixels of the spot
+	float metal;
+	int pixels;
+};
+
+enum TerrainClass {
+	TERRAIN_WATER = 0, //! below 0
+	TERRAIN_FLAT,	   //! slope below TERRAIN_HILL_SLOPE
+	TERRAIN_HILL,	   //! slope below TERRAIN_CLIFF_SLOPE, passable for most units
+	TERRAIN_CLIFF,
+	TERRAIN_CLASS_COUNT
+};
+
+//! slopes as rise over run, about 10 and 30 degrees
+static const float TERRAIN_HILL_SLOPE = 0.176f;
+static const float TERRAIN_CLIFF_SLOPE = 0.577f;
+
+//! summary of the terrain classes and slopes of a map
+struct TerrainStats
+{
+	TerrainStats()
+	    : valid(false)
+	    , minHeight(0.0f)
+	    , maxHeight(0.0f)
+	    , meanSlope(0.0f)
+	    , maxSlope(0.0f)
+	    , waterFraction(0.0f)
+	    , flatFraction(0.0f)
+	    , passableFraction(0.0f)
+	{
+	}
+	bool valid;
+	float minHeight;
+	float maxHeight;
+	//! over the land only
+	float meanSlope;
+	float maxSlope;
+	//! fractions of the whole map
+	float waterFraction;
+	float flatFraction;
+	//! land that isn't cliff
+	float passableFraction;
+};
+
+/** \brief clusters the pixels of a metal infomap with a value above threshold
+ *
+ * Pixels are connected with all 8 neighbours. Each pixel of the infomap
+ * covers scale map units and holds value / 255 * maxMetal metal.
+ * The spots are ordered by their topmost, then leftmost pixel.
+ */
+std::vector<MetalSpot> FindMetalSpots(const unsigned char* metal, int width, int height, unsigned char threshold, float scale, float maxMetal);
+
+//! pixels below this fraction of the peak value are the blurred border of a spot
+static const float METAL_SPOT_PEAK_FRACTION = 0.5f;
+//! more of the map above the threshold is a metal map without spots
+static const float METAL_MAP_COVERAGE = 0.25f;
+
+/** threshold for FindMetalSpots(): METAL_SPOT_PEAK_FRACTION of the highest
+ * value, so spots whose borders touch stay apart. 0xFF (no spots) for maps
+ * without metal and for metal maps, which have more than METAL_MAP_COVERAGE
+ * of their pixels above it. */
+unsigned char MetalSpotThreshold(const unsigned char* metal, size_t count);
+
+/** sets mask[i] to 0xFF where values[i] > threshold, 0 elsewhere.
+ * Vectorized with SSE2 where available. */
+void ThresholdMask(const unsigned char* values, unsigned char* mask, size_t count, unsigned char threshold);
+
+/** slope magnitude (rise over run) of every pixel of a height infomap from
+ * central differences, one sided at the borders. Heights are
+ * minHeight + value / 65535 * (maxHeight - minHeight), a pixel covers
+ * scale map units. Vectorized with SSE2 where available. */
+void ComputeSlopes(const unsigned short* heights, int width, int height, float minHeight, float maxHeight, float scale, float* slopes);
+
+//! TerrainClass of every pixel, classes has width * height entries
+void ClassifyTerrain(const unsigned short* heights, const float* slopes, int width, int height, float minHeight, float maxHeight, unsigned char* classes);
+
+TerrainStats ComputeTerrainStats(const unsigned short* heights, int width, int height, float minHeight, float maxHeight, float scale);
+
+} // namespace LSL
+
+#endif // LSL_HEADERGUARD_MAPANALYSIS_H
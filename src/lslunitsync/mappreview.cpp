@@ -0,0 +1,141 @@
+/* This file is part of the Springlobby (GPL v2 or later), see COPYING */
+
+#include "mappreview.h"
+
+#include <algorithm>
+
+namespace LSL
+{
+
+//! bilinear sample of an rgb image at u, v from 0 to 1
+static void SampleRGB(const unsigned char* rgb, int width, int height, float u, float v, float* out)
+{
+	const float x = std::max(0.0f, std::min(u * width - 0.5f, float(width - 1)));
+	const float y = std::max(0.0f, std::min(v * height - 0.5f, float(height - 1)));
+	const int x0 = (int)x;
+	const int y0 = (int)y;
+	const int x1 = std::min(x0 + 1, width - 1);
+	const int y1 = std::min(y0 + 1, height - 1);
+	const float fx = x - x0;
+	const float fy = y - y0;
+	const unsigned char* p00 = rgb + 3 * (y0 * width + x0);
+	const unsigned char* p10 = rgb + 3 * (y0 * width + x1);
+	const unsigned char* p01 = rgb + 3 * (y1 * width + x0);
+	const unsigned char* p11 = rgb + 3 * (y1 * width + x1);
+	for (int c = 0; c < 3; c++) {
+		const float top = p00[c] + (p10[c] - p00[c]) * fx;
+		const float bottom = p01[c] + (p11[c] - p01[c]) * fx;
+		out[c] = top + (bottom - top) * fy;
+	}
+}
+
+//! bilinear sample of a height infomap at u, v from 0 to 1
+static float SampleHeight(const unsigned short* heights, int width, int height, float u, float v)
+{
+	const float x = std::max(0.0f, std::min(u * (width - 1), float(width - 1)));
+	const float y = std::max(0.0f, std::min(v * (height - 1), float(height - 1)));
+	const int x0 = (int)x;
+	const int y0 = (int)y;
+	const int x1 = std::min(x0 + 1, width - 1);
+	const int y1 = std::min(y0 + 1, height - 1);
+	const float fx = x - x0;
+	const float fy = y - y0;
+	const float top = heights[y0 * width + x0] + (float(heights[y0 * width + x1]) - heights[y0 * width + x0]) * fx;
+	const float bottom = heights[y1 * width + x0] + (float(heights[y1 * width + x1]) - heights[y1 * width + x0]) * fx;
+	return top + (bottom - top) * fy;
+}
+
+template <class T>
+static T SampleNearest(const T* data, int width, int height, float u, float v)
+{
+	const int x = std::max(0, std::min(int(u * width), width - 1));
+	const int y = std::max(0, std::min(int(v * height), height - 1));
+	return data[y * width + x];
+}
+
+static unsigned char ToByte(float value)
+{
+	return (unsigned char)std::max(0.0f, std::min(value + 0.5f, 255.0f));
+}
+
+static void DrawMarker(unsigned char* rgb, int width, int height, int cx, int cy, int radius, const unsigned char* color)
+{
+	const int outer = (radius + 1) * (radius + 1);
+	const int inner = radius * radius;
+	for (int y = std::max(0, cy - radius - 1); y <= std::min(height - 1, cy + radius + 1); y++) {
+		for (int x = std::max(0, cx - radius - 1); x <= std::min(width - 1, cx + radius + 1); x++) {
+			const int dist = (x - cx) * (x - cx) + (y - cy) * (y - cy);
+			if (dist > outer)
+				continue;
+			unsigned char* pixel = rgb + 3 * (y * width + x);
+			for (int c = 0; c < 3; c++) {
+				pixel[c] = (dist > inner) ? 0 : color[c]; // black outline
+			}
+		}
+	}
+}
+
+void ComposeMapPreview(const MapPreviewSources& src, int layers, int width, int height, unsigned char* rgb)
+{
+	if (width <= 0 || height <= 0)
+		return;
+	const bool minimap = (layers & PREVIEW_MINIMAP) && src.minimap != NULL && src.minimapWidth > 0 && src.minimapHeight > 0;
+	const bool metal = (layers & PREVIEW_METAL) && src.metal != NULL && src.metalWidth > 0 && src.metalHeight > 0;
+	const bool shading = (layers & PREVIEW_HEIGHT) && src.heights != NULL && src.heightsWidth > 0 && src.heightsHeight > 0;
+	// the heights are compared one preview pixel apart in both directions,
+	// a ramp from the lowest to the highest point across the map gives +-0.25
+	const float shadegain = 0.125f * std::max(width, height) / 65535.0f;
+	const float du = 1.0f / width;
+	const float dv = 1.0f / height;
+
+	for (int y = 0; y < height; y++) {
+		const float v = (y + 0.5f) * dv;
+		unsigned char* out = rgb + 3 * y * width;
+		for (int x = 0; x < width; x++, out += 3) {
+			const float u = (x + 0.5f) * du;
+			float color[3] = {128.0f, 128.0f, 128.0f};
+			if (minimap) {
+				SampleRGB(src.minimap, src.minimapWidth, src.minimapHeight, u, v, color);
+			}
+			if (shading) {
+				const float nw = SampleHeight(src.heights, src.heightsWidth, src.heightsHeight, u - du, v - dv);
+				const float se = SampleHeight(src.heights, src.heightsWidth, src.heightsHeight, u + du, v + dv);
+				// slopes facing the light at the top left rise towards the bottom right
+				const float shade = std::max(0.5f, std::min(1.5f, 1.0f + (se - nw) * shadegain));
+				for (int c = 0; c < 3; c++)
+					color[c] *= shade;
+			}
+			if (metal) {
+				const float amount = SampleNearest(src.metal, src.metalWidth, src.metalHeight, u, v) * (0.7f / 255.0f);
+				color[0] -= color[0] * amount;
+				color[1] += (255.0f - color[1]) * amount;
+				color[2] -= color[2] * amount;
+			}
+			out[0] = ToByte(color[0]);
+			out[1] = ToByte(color[1]);
+			out[2] = ToByte(color[2]);
+		}
+	}
+
+	if ((layers & PREVIEW_STARTPOS) && src.mapWidth > 0 && src.mapHeight > 0) {
+		static const unsigned char colors[][3] = {
+		    {255, 255, 255},
+		    {255, 64, 64},
+		    {64, 128, 255},
+		    {255, 255, 0},
+		    {255, 0, 255},
+		    {0, 255, 255},
+		    {255, 128, 0},
+		    {160, 96, 255},
+		};
+		const int numColors = sizeof(colors) / sizeof(colors[0]);
+		const int radius = std::max(2, std::min(width, height) / 40);
+		for (size_t i = 0; i < src.positions.size(); i++) {
+			const int cx = int(float(src.positions[i].x) / src.mapWidth * width);
+			const int cy = int(float(src.positions[i].y) / src.mapHeight * height);
+			DrawMarker(rgb, width, height, cx, cy, radius, colors[i % numColors]);
+		}
+	}
+}
+
+} // namespace LSL
@@ -0,0 +1,67 @@
+/* This file is part of the Springlobby (GPL v2 or later), see COPYING */
+
+#ifndef LSL_HEADERGUARD_MAPPREVIEW_H
+#define LSL_HEADERGUARD_MAPPREVIEW_H
+
+#include <vector>
+
+#include "data.h"
+
+namespace LSL
+{
+
+//! layers of Unitsync::GetMapPreview(), may be combined
+enum MapPreviewLayer {
+	PREVIEW_MINIMAP = 1,
+	PREVIEW_METAL = 2,	//! green tint where the map has metal
+	PREVIEW_HEIGHT = 4,	//! hill shading lit from the top left
+	PREVIEW_STARTPOS = 8,	//! a dot per start position, colored by its index
+	PREVIEW_ALL = PREVIEW_MINIMAP | PREVIEW_METAL | PREVIEW_HEIGHT | PREVIEW_STARTPOS
+};
+
+//! the unscaled inputs of ComposeMapPreview(), sources of unused layers may be left empty
+struct MapPreviewSources
+{
+	MapPreviewSources()
+	    : minimap(NULL)
+	    , minimapWidth(0)
+	    , minimapHeight(0)
+	    , metal(NULL)
+	    , metalWidth(0)
+	    , metalHeight(0)
+	    , heights(NULL)
+	    , heightsWidth(0)
+	    , heightsHeight(0)
+	    , mapWidth(0)
+	    , mapHeight(0)
+	{
+	}
+	//! 3 bytes per pixel
+	const unsigned char* minimap;
+	int minimapWidth;
+	int minimapHeight;
+	//! metal infomap
+	const unsigned char* metal;
+	int metalWidth;
+	int metalHeight;
+	//! height infomap
+	const unsigned short* heights;
+	int heightsWidth;
+	int heightsHeight;
+	//! in map units, like the start positions
+	std::vector<StartPos> positions;
+	int mapWidth;
+	int mapHeight;
+};
+
+/** \brief renders the enabled layers into rgb (3 bytes per pixel, width * height pixels)
+ *
+ * Minimap, metal and height are sampled and blended per pixel in a single
+ * pass, the start position markers are drawn on top afterwards. Without
+ * the minimap layer the base color is a neutral gray.
+ */
+void ComposeMapPreview(const MapPreviewSources& src, int layers, int width, int height, unsigned char* rgb);
+
+} // namespace LSL
+
+#endif // LSL_HEADERGUARD_MAPPREVIEW_H
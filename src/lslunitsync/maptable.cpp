@@ -0,0 +1,73 @@
+/* This file is part of the Springlobby (GPL v2 or later), see COPYING */
+
+#include "maptable.h"
+
+#include "data.h"
+
+namespace LSL
+{
+
+MapTable::MapTable()
+    : m_knowncount(0)
+{
+}
+
+void MapTable::Reserve(size_t count)
+{
+	m_names.reserve(count);
+	m_known.reserve(count);
+	for (int c = 0; c < COL_COUNT; c++) {
+		m_columns[c].reserve(count);
+	}
+}
+
+void MapTable::Add(const std::string& mapname, const MapSummary* info)
+{
+	m_names.push_back(mapname);
+	m_known.push_back(info != NULL);
+	if (info == NULL) {
+		for (int c = 0; c < COL_COUNT; c++) {
+			m_columns[c].push_back(0.0f);
+		}
+		return;
+	}
+	m_knowncount++;
+	m_columns[COL_WIDTH].push_back(info->width);
+	m_columns[COL_HEIGHT].push_back(info->height);
+	m_columns[COL_TIDAL_STRENGTH].push_back(info->tidalStrength);
+	m_columns[COL_GRAVITY].push_back(info->gravity);
+	m_columns[COL_MAX_METAL].push_back(info->maxMetal);
+	m_columns[COL_EXTRACTOR_RADIUS].push_back(info->extractorRadius);
+	m_columns[COL_MIN_WIND].push_back(info->minWind);
+	m_columns[COL_MAX_WIND].push_back(info->maxWind);
+	m_columns[COL_START_POSITIONS].push_back(info->positionCount);
+}
+
+std::vector<int> MapTable::Query(const std::vector<Range>& ranges) const
+{
+	const size_t count = size();
+	// narrow a byte mask column by column, the inner loops are branch free
+	std::vector<unsigned char> mask(m_known);
+	for (const Range& range : ranges) {
+		const float* col = m_columns[range.column].data();
+		const float min = range.min;
+		const float max = range.max;
+		unsigned char* m = mask.data();
+		for (size_t i = 0; i < count; i++) {
+			m[i] &= (col[i] >= min) & (col[i] <= max);
+		}
+	}
+	std::vector<int> ret;
+	for (size_t i = 0; i < count; i++) {
+		if (mask[i])
+			ret.push_back(i);
+	}
+	return ret;
+}
+
+std::vector<int> MapTable::Query(Column column, float min, float max) const
+{
+	return Query(std::vector<Range>(1, Range(column, min, max)));
+}
+
+} // namespace LSL
@@ -0,0 +1,108 @@
+/* This file is part of the Springlobby (GPL v2 or later), see COPYING */
+
+#ifndef LSL_HEADERGUARD_MAPTABLE_H
+#define LSL_HEADERGUARD_MAPTABLE_H
+
+#include <string>
+#include <vector>
+
+namespace LSL
+{
+
+struct MapSummary;
+
+/** \brief column store of the numeric MapInfo fields of all maps
+ *
+ * Row i belongs to the i-th map of Unitsync::GetMapList() at the time the
+ * table was built, GetName() returns its name. Every field is kept in its own
+ * float array, so a query only touches the columns it filters on.
+ * Maps without cached MapInfo are kept as unknown rows and never match a query.
+ */
+class MapTable
+{
+public:
+	enum Column {
+		COL_WIDTH = 0,
+		COL_HEIGHT,
+		COL_TIDAL_STRENGTH,
+		COL_GRAVITY,
+		COL_MAX_METAL,
+		COL_EXTRACTOR_RADIUS,
+		COL_MIN_WIND,
+		COL_MAX_WIND,
+		COL_START_POSITIONS,
+		COL_COUNT
+	};
+
+	//! inclusive range condition on one column
+	struct Range
+	{
+		Range(Column column, float min, float max)
+		    : column(column)
+		    , min(min)
+		    , max(max)
+		{
+		}
+		Column column;
+		float min;
+		float max;
+	};
+
+	MapTable();
+
+	void Reserve(size_t count);
+	//! appends a row, info is NULL if the MapInfo of the map isn't known
+	void Add(const std::string& mapname, const MapSummary* info);
+
+	size_t size() const
+	{
+		return m_names.size();
+	}
+	size_t KnownCount() const
+	{
+		return m_knowncount;
+	}
+	bool IsKnown(int index) const
+	{
+		return m_known[index] != 0;
+	}
+	const std::string& GetName(int index) const
+	{
+		return m_names[index];
+	}
+	float Get(Column column, int index) const
+	{
+		return m_columns[column][index];
+	}
+	const std::vector<float>& GetColumn(Column column) const
+	{
+		return m_columns[column];
+	}
+
+	//! indices of all known maps matching all ranges, in ascending order
+	std::vector<int> Query(const std::vector<Range>& ranges) const;
+	std::vector<int> Query(Column column, float min, float max) const;
+
+	//! indices of all known maps for which pred(table, index) returns true
+	template <typename Predicate>
+	std::vector<int> Filter(Predicate pred) const
+	{
+		std::vector<int> ret;
+		const int count = size();
+		for (int i = 0; i < count; i++) {
+			if (m_known[i] && pred(*this, i))
+				ret.push_back(i);
+		}
+		return ret;
+	}
+
+private:
+	std::vector<std::string> m_names;
+	std::vector<unsigned char> m_known;
+	std::vector<float> m_columns[COL_COUNT];
+	size_t m_knowncount;
+};
+
+} // namespace LSL
+
+#endif // LSL_HEADERGUARD_MAPTABLE_H
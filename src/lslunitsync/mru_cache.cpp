@@ -0,0 +1,89 @@
+/* This file is part of the Springlobby (GPL v2 or later), see COPYING */
+
+#include "mru_cache.h"
+
+#include <algorithm>
+
+namespace LSL
+{
+
+MemoryGovernor::MemoryGovernor(size_t budget)
+    : m_budget(budget)
+    , m_tick(0)
+{
+}
+
+void MemoryGovernor::Register(GovernedCache* cache)
+{
+	boost::mutex::scoped_lock lock(m_lock);
+	m_caches.push_back(cache);
+}
+
+void MemoryGovernor::Unregister(GovernedCache* cache)
+{
+	boost::mutex::scoped_lock lock(m_lock);
+	m_caches.erase(std::remove(m_caches.begin(), m_caches.end(), cache), m_caches.end());
+}
+
+void MemoryGovernor::SetBudget(size_t budget)
+{
+	m_budget = budget;
+	Enforce();
+}
+
+size_t MemoryGovernor::GetUsage() const
+{
+	boost::mutex::scoped_lock lock(m_lock);
+	size_t ret = 0;
+	for (const GovernedCache* cache : m_caches) {
+		ret += cache->GetMemoryUsage();
+	}
+	return ret;
+}
+
+std::map<std::string, size_t> MemoryGovernor::GetUsageByCache() const
+{
+	boost::mutex::scoped_lock lock(m_lock);
+	std::map<std::string, size_t> ret;
+	for (const GovernedCache* cache : m_caches) {
+		ret[cache->GetName()] += cache->GetMemoryUsage();
+	}
+	return ret;
+}
+
+void MemoryGovernor::Enforce()
+{
+	boost::mutex::scoped_lock lock(m_lock);
+	const size_t budget = m_budget;
+	if (budget == 0)
+		return;
+	const unsigned long now = m_tick;
+	for (;;) {
+		size_t usage = 0;
+		for (const GovernedCache* cache : m_caches) {
+			usage += cache->GetMemoryUsage();
+		}
+		if (usage <= budget)
+			return;
+		// big items which weren't used for a long time go first
+		GovernedCache* victim = NULL;
+		double victimscore = -1.0;
+		for (GovernedCache* cache : m_caches) {
+			unsigned long tick;
+			size_t cost;
+			if (!cache->GetEvictionCandidate(tick, cost))
+				continue;
+			const double idle = (now >= tick) ? (now - tick + 1) : 1;
+			const double score = idle * cost / cache->GetWeight();
+			if (score > victimscore) {
+				victim = cache;
+				victimscore = score;
+			}
+		}
+		if (victim == NULL)
+			return;
+		victim->EvictOldest();
+	}
+}
+
+} // namespace LSL
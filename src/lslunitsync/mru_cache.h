@@ -7,79 +7,292 @@
 
 #include <string>
 #include <boost/thread/mutex.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
 #ifdef WIN32 //undefine windows header pollution
 #ifdef GetUserName
 #undef GetUserName
 #endif
 #endif
+#include <atomic>
+#include <iterator>
 #include <list>
 #include <map>
+#include <vector>
 
 namespace LSL
 {
 
-/// Thread safe MRU cache (works like a std::map but has maximum size)
+/// Interface the MemoryGovernor uses to inspect and shrink a cache
+class GovernedCache
+{
+public:
+	virtual ~GovernedCache()
+	{
+	}
+	virtual const std::string& GetName() const = 0;
+	//! estimated memory used by all items in bytes
+	virtual size_t GetMemoryUsage() const = 0;
+	//! last use tick and cost of the least recently used item, false if empty
+	virtual bool GetEvictionCandidate(unsigned long& tick, size_t& cost) const = 0;
+	//! removes the least recently used item
+	virtual void EvictOldest() = 0;
+	//! how expensive items are to recreate, items of caches with a higher weight stay longer
+	virtual double GetWeight() const = 0;
+};
+
+/** \brief keeps the memory of all registered caches below a common budget
+ *
+ * When the budget is exceeded, the governor evicts the item with the highest
+ * (idle ticks * cost / weight) over all caches, until usage fits again.
+ * Lock order: the governor lock is always taken before a cache lock,
+ * caches must not hold their own lock when calling Enforce().
+ */
+class MemoryGovernor : public boost::noncopyable
+{
+public:
+	explicit MemoryGovernor(size_t budget);
+
+	void Register(GovernedCache* cache);
+	void Unregister(GovernedCache* cache);
+
+	//! 0 means no limit
+	void SetBudget(size_t budget);
+	size_t GetBudget() const
+	{
+		return m_budget;
+	}
+	size_t GetUsage() const;
+	//! cache name -> usage in bytes
+	std::map<std::string, size_t> GetUsageByCache() const;
+
+	//! evicts items until usage is within budget
+	void Enforce();
+
+	//! monotonic clock for LRU ordering across caches
+	unsigned long Tick()
+	{
+		return ++m_tick;
+	}
+
+private:
+	mutable boost::mutex m_lock;
+	std::vector<GovernedCache*> m_caches;
+	std::atomic<size_t> m_budget;
+	std::atomic<unsigned long> m_tick;
+};
+
+/** \brief estimated memory used by a cached item, in bytes
+ *
+ * By default the value type reports its heap memory itself with
+ * size_t GetMemoryUsage() const, sizeof(TValue) is added here.
+ */
 template <typename TValue>
-class MostRecentlyUsedCache
+struct CacheMemoryCost
+{
+	size_t operator()(const TValue& value) const
+	{
+		return sizeof(TValue) + value.GetMemoryUsage();
+	}
+};
+
+//! shared immutable values are counted in full by every cache holding them
+template <typename TValue>
+struct CacheMemoryCost<boost::shared_ptr<const TValue>>
+{
+	size_t operator()(const boost::shared_ptr<const TValue>& value) const
+	{
+		return sizeof(value) + (value ? CacheMemoryCost<TValue>()(*value) : 0);
+	}
+};
+
+template <>
+struct CacheMemoryCost<std::vector<std::string>>
+{
+	size_t operator()(const std::vector<std::string>& strings) const
+	{
+		size_t ret = sizeof(strings) + (strings.capacity() - strings.size()) * sizeof(std::string);
+		for (const std::string& str : strings) {
+			ret += sizeof(std::string) + str.capacity();
+		}
+		return ret;
+	}
+};
+
+//! for values without heap memory
+template <typename TValue>
+struct FixedMemoryCost
+{
+	size_t operator()(const TValue&) const
+	{
+		return sizeof(TValue);
+	}
+};
+
+//! for vectors of values without heap memory
+template <typename TValue>
+struct FixedVectorMemoryCost
+{
+	size_t operator()(const std::vector<TValue>& values) const
+	{
+		return sizeof(values) + values.capacity() * sizeof(TValue);
+	}
+};
+
+/// Thread safe LRU cache (works like a std::map but has maximum size),
+/// optionally accounting its memory against a MemoryGovernor.
+/// TCost estimates the memory of an item, see CacheMemoryCost
+template <typename TValue, typename TCost = CacheMemoryCost<TValue>>
+class MostRecentlyUsedCache : public GovernedCache
 {
 public:
 	//! name parameter might be used to identify stats in dgb output
-	MostRecentlyUsedCache(size_t max_size, const std::string& name = "")
+	MostRecentlyUsedCache(size_t max_size, const std::string& name = "", MemoryGovernor* governor = NULL, double weight = 1.0)
 	    : m_max_size(max_size)
 	    , m_cache_hits(0)
 	    , m_cache_misses(0)
 	    , m_name(name)
+	    , m_governor(governor)
+	    , m_weight(weight)
+	    , m_memory(0)
+	    , m_tick(0)
 	{
+		if (m_governor != NULL)
+			m_governor->Register(this);
 	}
 
 	~MostRecentlyUsedCache()
 	{
+		if (m_governor != NULL)
+			m_governor->Unregister(this);
 		LslDebug("%s - cache hits: %d misses: %d", m_name.c_str(), m_cache_hits, m_cache_misses);
 	}
 
 	void Add(const std::string& name, const TValue& img)
 	{
-		boost::mutex::scoped_lock lock(m_lock);
-		if (m_itemnames.size() > m_max_size) {
-			m_items.erase(m_itemnames.back());
-			m_itemnames.pop_back();
+		{
+			boost::mutex::scoped_lock lock(m_lock);
+			auto it = m_index.find(name);
+			if (it != m_index.end()) {
+				Erase(it->second);
+			}
+			m_items.push_front(Entry(name, img, TCost()(img), NextTick()));
+			m_index[name] = m_items.begin();
+			m_memory += m_items.front().cost;
+			while (m_items.size() > m_max_size) {
+				Erase(std::prev(m_items.end()));
+			}
 		}
-		m_itemnames.push_front(name);
-		m_items[name] = img;
+		// cache lock has to be released, the governor locks caches itself
+		if (m_governor != NULL)
+			m_governor->Enforce();
 	}
 
 	bool TryGet(const std::string& name, TValue& img)
 	{
 		boost::mutex::scoped_lock lock(m_lock);
 
-		auto it = m_items.find(name);
-		if (it == m_items.end()) {
+		auto it = m_index.find(name);
+		if (it == m_index.end()) {
 			++m_cache_misses;
 			return false;
 		}
-		// reinsert at front, so that most recently used items are always at front
-		m_itemnames.push_front(m_itemnames.back());
-		m_itemnames.pop_back();
+		// move to front, so that most recently used items are always at front
+		m_items.splice(m_items.begin(), m_items, it->second);
+		it->second->tick = NextTick();
 		++m_cache_hits;
-		img = it->second; //copy!
+		img = it->second->value; //copy!
 		return true;
 	}
 
+	void Remove(const std::string& name)
+	{
+		boost::mutex::scoped_lock lock(m_lock);
+		auto it = m_index.find(name);
+		if (it != m_index.end())
+			Erase(it->second);
+	}
+
 	void Clear()
 	{
 		boost::mutex::scoped_lock lock(m_lock);
 		m_items.clear();
-		m_itemnames.clear();
+		m_index.clear();
+		m_memory = 0;
+	}
+
+	const std::string& GetName() const
+	{
+		return m_name;
+	}
+
+	size_t GetMemoryUsage() const
+	{
+		return m_memory;
+	}
+
+	bool GetEvictionCandidate(unsigned long& tick, size_t& cost) const
+	{
+		boost::mutex::scoped_lock lock(m_lock);
+		if (m_items.empty())
+			return false;
+		tick = m_items.back().tick;
+		cost = m_items.back().cost;
+		return true;
+	}
+
+	void EvictOldest()
+	{
+		boost::mutex::scoped_lock lock(m_lock);
+		if (!m_items.empty())
+			Erase(std::prev(m_items.end()));
+	}
+
+	double GetWeight() const
+	{
+		return m_weight;
 	}
 
 private:
+	struct Entry
+	{
+		Entry(const std::string& name, const TValue& value, size_t cost, unsigned long tick)
+		    : name(name)
+		    , value(value)
+		    , cost(cost)
+		    , tick(tick)
+		{
+		}
+		std::string name;
+		TValue value;
+		size_t cost;
+		unsigned long tick;
+	};
+	typedef std::list<Entry> EntryList;
+
+	void Erase(typename EntryList::iterator it)
+	{
+		m_memory -= it->cost;
+		m_index.erase(it->name);
+		m_items.erase(it);
+	}
+
+	unsigned long NextTick()
+	{
+		return m_governor != NULL ? m_governor->Tick() : ++m_tick;
+	}
+
 	mutable boost::mutex m_lock;
-	std::list<std::string> m_itemnames;
-	std::map<std::string,TValue> m_items;
+	EntryList m_items; //! most recently used first
+	std::map<std::string, typename EntryList::iterator> m_index;
 	const size_t m_max_size;
 	int m_cache_hits;
 	int m_cache_misses;
 	const std::string m_name;
+	MemoryGovernor* m_governor;
+	const double m_weight;
+	std::atomic<size_t> m_memory;
+	unsigned long m_tick;
 };
 
 class UnitsyncImage;
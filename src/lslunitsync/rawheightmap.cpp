@@ -0,0 +1,184 @@
+/* This file is part of the Springlobby (GPL v2 or later), see COPYING */
+
+#include "rawheightmap.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <zlib.h>
+
+#include <lslutils/misc.h>
+
+namespace LSL
+{
+
+//! cache file header, followed by width and height as little endian int32 and the compressed data
+static const char RAWHEIGHTMAP_MAGIC[8] = {'L', 'S', 'L', 'H', 'M', 'A', 'P', '1'};
+//! sanity limit, spring maps are at most 64x64 (4097x4097 heights)
+static const int RAWHEIGHTMAP_MAX_SIZE = 8193;
+
+RawHeightmap::RawHeightmap()
+    : m_width(0)
+    , m_height(0)
+    , m_min(0)
+    , m_max(0)
+    , m_mean(0.0)
+{
+}
+
+RawHeightmap::RawHeightmap(int width, int height, std::vector<unsigned short>& data)
+    : m_width(width)
+    , m_height(height)
+    , m_min(0)
+    , m_max(0)
+    , m_mean(0.0)
+{
+	if (width > 0 && height > 0 && data.size() == (size_t)width * height) {
+		m_data.swap(data);
+	} else {
+		m_width = 0;
+		m_height = 0;
+	}
+	UpdateStats();
+}
+
+void RawHeightmap::UpdateStats()
+{
+	if (m_data.empty()) {
+		m_min = m_max = 0;
+		m_mean = 0.0;
+		return;
+	}
+	unsigned short lo = 0xFFFF;
+	unsigned short hi = 0;
+	unsigned long long sum = 0;
+	for (const unsigned short h : m_data) {
+		lo = std::min(lo, h);
+		hi = std::max(hi, h);
+		sum += h;
+	}
+	m_min = lo;
+	m_max = hi;
+	m_mean = (double)sum / m_data.size();
+}
+
+std::vector<unsigned int> RawHeightmap::GetHistogram(int buckets) const
+{
+	buckets = std::max(1, std::min(buckets, 65536));
+	std::vector<unsigned int> ret(buckets, 0);
+	for (const unsigned short h : m_data) {
+		ret[(h * buckets) >> 16]++;
+	}
+	return ret;
+}
+
+float RawHeightmap::Sample(float x, float y) const
+{
+	if (m_data.empty())
+		return 0.0f;
+	x = std::max(0.0f, std::min(x, (float)(m_width - 1)));
+	y = std::max(0.0f, std::min(y, (float)(m_height - 1)));
+	const int x0 = (int)x;
+	const int y0 = (int)y;
+	const int x1 = std::min(x0 + 1, m_width - 1);
+	const int y1 = std::min(y0 + 1, m_height - 1);
+	const float fx = x - x0;
+	const float fy = y - y0;
+	const float top = Get(x0, y0) + (Get(x1, y0) - Get(x0, y0)) * fx;
+	const float bottom = Get(x0, y1) + (Get(x1, y1) - Get(x0, y1)) * fx;
+	return top + (bottom - top) * fy;
+}
+
+float RawHeightmap::SampleRelative(float u, float v) const
+{
+	return Sample(u * (m_width - 1), v * (m_height - 1));
+}
+
+static void WriteInt(unsigned char* p, unsigned int val)
+{
+	p[0] = val & 0xFF;
+	p[1] = (val >> 8) & 0xFF;
+	p[2] = (val >> 16) & 0xFF;
+	p[3] = (val >> 24) & 0xFF;
+}
+
+static unsigned int ReadInt(const unsigned char* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+bool RawHeightmap::Save(const std::string& path) const
+{
+	if (m_data.empty())
+		return false;
+	// terrain is smooth, the difference to the left neighbour compresses much better
+	std::vector<unsigned char> raw(m_data.size() * 2);
+	for (int y = 0; y < m_height; y++) {
+		unsigned short prev = 0;
+		for (int x = 0; x < m_width; x++) {
+			const size_t i = (size_t)y * m_width + x;
+			const unsigned short delta = m_data[i] - prev;
+			prev = m_data[i];
+			raw[i * 2] = delta & 0xFF;
+			raw[i * 2 + 1] = delta >> 8;
+		}
+	}
+	uLongf len = compressBound(raw.size());
+	std::vector<unsigned char> buf(sizeof(RAWHEIGHTMAP_MAGIC) + 8 + len);
+	if (compress2(&buf[sizeof(RAWHEIGHTMAP_MAGIC) + 8], &len, &raw[0], raw.size(), Z_DEFAULT_COMPRESSION) != Z_OK)
+		return false;
+	memcpy(&buf[0], RAWHEIGHTMAP_MAGIC, sizeof(RAWHEIGHTMAP_MAGIC));
+	WriteInt(&buf[sizeof(RAWHEIGHTMAP_MAGIC)], m_width);
+	WriteInt(&buf[sizeof(RAWHEIGHTMAP_MAGIC) + 4], m_height);
+	buf.resize(sizeof(RAWHEIGHTMAP_MAGIC) + 8 + len);
+
+	FILE* file = Util::lslopen(path, "wb");
+	if (file == NULL)
+		return false;
+	const bool ok = fwrite(&buf[0], buf.size(), 1, file) == 1;
+	fclose(file);
+	return ok;
+}
+
+bool RawHeightmap::Load(const std::string& path)
+{
+	FILE* file = Util::lslopen(path, "rb");
+	if (file == NULL)
+		return false;
+	std::vector<unsigned char> buf;
+	unsigned char chunk[64 * 1024];
+	size_t read;
+	while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+		buf.insert(buf.end(), chunk, chunk + read);
+	}
+	fclose(file);
+
+	const size_t headersize = sizeof(RAWHEIGHTMAP_MAGIC) + 8;
+	if (buf.size() <= headersize || memcmp(&buf[0], RAWHEIGHTMAP_MAGIC, sizeof(RAWHEIGHTMAP_MAGIC)) != 0)
+		return false;
+	const int width = ReadInt(&buf[sizeof(RAWHEIGHTMAP_MAGIC)]);
+	const int height = ReadInt(&buf[sizeof(RAWHEIGHTMAP_MAGIC) + 4]);
+	if (width <= 0 || height <= 0 || width > RAWHEIGHTMAP_MAX_SIZE || height > RAWHEIGHTMAP_MAX_SIZE)
+		return false;
+	std::vector<unsigned char> raw((size_t)width * height * 2);
+	uLongf len = raw.size();
+	if (uncompress(&raw[0], &len, &buf[headersize], buf.size() - headersize) != Z_OK || len != raw.size())
+		return false;
+
+	std::vector<unsigned short> data((size_t)width * height);
+	for (int y = 0; y < height; y++) {
+		unsigned short prev = 0;
+		for (int x = 0; x < width; x++) {
+			const size_t i = (size_t)y * width + x;
+			prev += raw[i * 2] | (raw[i * 2 + 1] << 8);
+			data[i] = prev;
+		}
+	}
+	m_width = width;
+	m_height = height;
+	m_data.swap(data);
+	UpdateStats();
+	return true;
+}
+
+} // namespace LSL
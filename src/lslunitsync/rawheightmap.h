@@ -0,0 +1,86 @@
+/* This file is part of the Springlobby (GPL v2 or later), see COPYING */
+
+#ifndef LSL_HEADERGUARD_RAWHEIGHTMAP_H
+#define LSL_HEADERGUARD_RAWHEIGHTMAP_H
+
+#include <string>
+#include <vector>
+
+namespace LSL
+{
+
+/** \brief heights of a map as returned by unitsync's height infomap
+ *
+ * One unsigned 16 bit value per heightmap pixel, row by row, scaled by
+ * unitsync so 0 is the lowest and 65535 the highest point of the map.
+ */
+class RawHeightmap
+{
+public:
+	RawHeightmap();
+	//! takes data, which has to contain width * height values
+	RawHeightmap(int width, int height, std::vector<unsigned short>& data);
+
+	bool isValid() const
+	{
+		return !m_data.empty();
+	}
+	int GetWidth() const
+	{
+		return m_width;
+	}
+	int GetHeight() const
+	{
+		return m_height;
+	}
+	const unsigned short* GetData() const
+	{
+		return m_data.empty() ? NULL : &m_data[0];
+	}
+	unsigned short Get(int x, int y) const
+	{
+		return m_data[y * m_width + x];
+	}
+
+	unsigned short GetMin() const
+	{
+		return m_min;
+	}
+	unsigned short GetMax() const
+	{
+		return m_max;
+	}
+	double GetMean() const
+	{
+		return m_mean;
+	}
+	//! number of pixels per height range, the buckets split 0..65535 evenly
+	std::vector<unsigned int> GetHistogram(int buckets = 256) const;
+	//! bilinear interpolated height at a position in pixels, clamped to the map
+	float Sample(float x, float y) const;
+	//! Sample() with u, v from 0 to 1 across the map
+	float SampleRelative(float u, float v) const;
+
+	//! delta coded and zlib compressed
+	bool Save(const std::string& path) const;
+	bool Load(const std::string& path);
+
+	size_t GetMemoryUsage() const
+	{
+		return m_data.capacity() * sizeof(unsigned short);
+	}
+
+private:
+	void UpdateStats();
+
+	int m_width;
+	int m_height;
+	std::vector<unsigned short> m_data;
+	unsigned short m_min;
+	unsigned short m_max;
+	double m_mean;
+};
+
+} // namespace LSL
+
+#endif // LSL_HEADERGUARD_RAWHEIGHTMAP_H
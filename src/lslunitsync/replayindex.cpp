@@ -0,0 +1,366 @@
+/* This file is part of the Springlobby (GPL v2 or later), see COPYING */
+
+#include "replayindex.h"
+
+#include <atomic>
+#include <utility>
+#include <stdio.h>
+#include <string.h>
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <lslutils/misc.h>
+#include <lslutils/debug.h>
+#include <lslutils/demofile.h>
+
+namespace LSL
+{
+
+static const char REPLAYINDEX_MAGIC[] = "LSLREPLAYIDX";
+static const int REPLAYINDEX_VERSION = 2;
+//! sanity limit for strings in the cache file
+static const unsigned int MAX_STRING_SIZE = 1024 * 1024;
+
+ReplayIndex::ReplayIndex()
+{
+}
+
+//! extracts map, game and the names of the playing players from a start script
+static void ParseScript(ReplayInfo& info)
+{
+	// tdf: [section] { key=value; ... }, keys and section names are case insensitive
+	std::vector<std::string> sections;
+	std::string pending;
+	std::string playername;
+	bool spectator = false;
+	const std::string& script = info.script;
+	size_t pos = 0;
+	while (pos < script.size()) {
+		const char c = script[pos];
+		if (c == '[') {
+			const size_t end = script.find(']', pos);
+			if (end == std::string::npos)
+				break;
+			pending = boost::algorithm::to_lower_copy(script.substr(pos + 1, end - pos - 1));
+			pos = end + 1;
+		} else if (c == '{') {
+			sections.push_back(pending);
+			pending.clear();
+			playername.clear();
+			spectator = false;
+			pos++;
+		} else if (c == '}') {
+			if (sections.size() == 2 && sections[0] == "game" && boost::algorithm::starts_with(sections[1], "player")) {
+				if (!spectator && !playername.empty())
+					info.players.push_back(playername);
+			}
+			if (!sections.empty())
+				sections.pop_back();
+			pos++;
+		} else if (isspace((unsigned char)c) || c == ';') {
+			pos++;
+		} else {
+			const size_t end = script.find_first_of(";{}[", pos);
+			const std::string line = script.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+			pos = (end == std::string::npos) ? script.size() : end;
+			const size_t eq = line.find('=');
+			if (eq == std::string::npos)
+				continue;
+			const std::string key = boost::algorithm::to_lower_copy(boost::algorithm::trim_copy(line.substr(0, eq)));
+			const std::string value = boost::algorithm::trim_copy(line.substr(eq + 1));
+			if (sections.size() == 1 && sections[0] == "game") {
+				if (key == "mapname")
+					info.map = value;
+				else if (key == "gametype")
+					info.game = value;
+			} else if (sections.size() == 2 && sections[0] == "game") {
+				if (key == "name")
+					playername = value;
+				else if (key == "spectator")
+					spectator = (value == "1");
+			}
+		}
+	}
+}
+
+bool ReplayIndex::ReadReplayInfo(ReplayInfo& info)
+{
+	info.parsed = false;
+	Util::DemoHeader header;
+	if (!Util::ReadDemoHeader(info.path, header, &info.script)) {
+		info.script.clear();
+		return false;
+	}
+	info.version = header.version;
+	info.engine = header.engine;
+	info.gameid = header.gameid;
+	info.unixtime = header.unixtime;
+	info.gametime = header.gametime;
+	info.wallclocktime = header.wallclocktime;
+	info.numplayers = header.numplayers;
+	info.players.clear();
+	ParseScript(info);
+	info.parsed = true;
+	return true;
+}
+
+static void ListDir(const std::string& dir, const StringVector& extensions, StringVector& files)
+{
+	try {
+		if (!boost::filesystem::is_directory(dir))
+			return;
+		boost::filesystem::directory_iterator enditer;
+		for (boost::filesystem::directory_iterator it(dir); it != enditer; ++it) {
+			if (!boost::filesystem::is_regular_file(it->status()))
+				continue;
+			const std::string filename = it->path().string();
+			for (const std::string& ext : extensions) {
+				if (boost::algorithm::iends_with(filename, ext)) {
+					files.push_back(filename);
+					break;
+				}
+			}
+		}
+	} catch (std::exception& e) {
+		LslWarning("Couldn't list %s: %s", dir.c_str(), e.what());
+	}
+}
+
+size_t ReplayIndex::Refresh(const StringVector& dirs, const StringVector& extensions, int threads)
+{
+	boost::mutex::scoped_lock refreshlock(m_refresh_lock);
+	if (threads <= 0)
+		threads = std::max(1u, std::min(16u, boost::thread::hardware_concurrency()));
+
+	// list all dirs in parallel
+	std::vector<StringVector> listings(dirs.size());
+	{
+		boost::thread_group group;
+		for (size_t i = 0; i < dirs.size(); i++) {
+			group.create_thread([&dirs, &extensions, &listings, i]() { ListDir(dirs[i], extensions, listings[i]); });
+		}
+		group.join_all();
+	}
+	std::vector<ReplayInfo> files;
+	for (const StringVector& listing : listings) {
+		for (const std::string& path : listing) {
+			files.push_back(ReplayInfo());
+			files.back().path = path;
+		}
+	}
+
+	// stat all files and read the headers of new / changed ones
+	std::vector<char> unchanged(files.size(), 0);
+	std::atomic<size_t> next(0);
+	{
+		boost::thread_group group;
+		for (int t = 0; t < threads; t++) {
+			group.create_thread([this, &files, &unchanged, &next]() {
+				for (size_t i = next++; i < files.size(); i = next++) {
+					ReplayInfo& info = files[i];
+					boost::system::error_code ec;
+					info.size = boost::filesystem::file_size(info.path, ec);
+					info.mtime = ec ? 0 : boost::filesystem::last_write_time(info.path, ec);
+					{
+						boost::mutex::scoped_lock lock(m_lock);
+						const auto it = m_replays.find(info.path);
+						if (it != m_replays.end() && it->second.size == info.size && it->second.mtime == info.mtime) {
+							unchanged[i] = 1;
+							continue;
+						}
+					}
+					ReadReplayInfo(info);
+				}
+			});
+		}
+		group.join_all();
+	}
+
+	size_t changed = 0;
+	{
+		boost::mutex::scoped_lock lock(m_lock);
+		std::map<std::string, ReplayInfo> replays;
+		for (size_t i = 0; i < files.size(); i++) {
+			if (unchanged[i]) {
+				replays[files[i].path] = std::move(m_replays[files[i].path]);
+			} else {
+				replays[files[i].path] = std::move(files[i]);
+				changed++;
+			}
+		}
+		for (const auto& it : m_replays) { // removed files
+			if (replays.find(it.first) == replays.end())
+				changed++;
+		}
+		m_replays.swap(replays);
+	}
+	if (changed > 0)
+		Save();
+	return changed;
+}
+
+std::vector<ReplayInfo> ReplayIndex::GetReplays(bool scripts) const
+{
+	boost::mutex::scoped_lock lock(m_lock);
+	std::vector<ReplayInfo> ret;
+	ret.reserve(m_replays.size());
+	for (const auto& it : m_replays) {
+		if (scripts) {
+			ret.push_back(it.second);
+		} else {
+			ReplayInfo info(it.second);
+			info.script.clear();
+			ret.push_back(info);
+		}
+	}
+	return ret;
+}
+
+bool ReplayIndex::GetReplay(const std::string& path, ReplayInfo& info) const
+{
+	boost::mutex::scoped_lock lock(m_lock);
+	const auto it = m_replays.find(path);
+	if (it == m_replays.end())
+		return false;
+	info = it->second;
+	return true;
+}
+
+void ReplayIndex::SetCacheFile(const std::string& path)
+{
+	{
+		boost::mutex::scoped_lock lock(m_lock);
+		if (path == m_cachefile)
+			return;
+		m_cachefile = path;
+		m_replays.clear();
+	}
+	Load();
+}
+
+// the cache file is local to this machine, so values are written in native byte order
+static void WriteString(FILE* file, const std::string& str)
+{
+	const unsigned int len = str.size();
+	fwrite(&len, sizeof(len), 1, file);
+	fwrite(str.data(), len, 1, file);
+}
+
+static bool ReadString(FILE* file, std::string& str)
+{
+	unsigned int len;
+	if (fread(&len, sizeof(len), 1, file) != 1 || len > MAX_STRING_SIZE)
+		return false;
+	str.resize(len);
+	return len == 0 || fread(&str[0], len, 1, file) == 1;
+}
+
+template <typename T>
+static void WriteValue(FILE* file, const T& val)
+{
+	fwrite(&val, sizeof(val), 1, file);
+}
+
+template <typename T>
+static bool ReadValue(FILE* file, T& val)
+{
+	return fread(&val, sizeof(val), 1, file) == 1;
+}
+
+bool ReplayIndex::Load()
+{
+	std::string cachefile;
+	{
+		boost::mutex::scoped_lock lock(m_lock);
+		cachefile = m_cachefile;
+	}
+	FILE* file = Util::lslopen(cachefile, "rb");
+	if (file == NULL)
+		return false;
+	std::map<std::string, ReplayInfo> replays;
+	char magic[sizeof(REPLAYINDEX_MAGIC)];
+	int version = 0;
+	unsigned int count = 0;
+	bool ok = fread(magic, sizeof(magic), 1, file) == 1 && memcmp(magic, REPLAYINDEX_MAGIC, sizeof(magic)) == 0 &&
+		  ReadValue(file, version) && version == REPLAYINDEX_VERSION && ReadValue(file, count);
+	for (unsigned int i = 0; ok && i < count; i++) {
+		ReplayInfo info;
+		unsigned long long mtime = 0;
+		char parsed = 0;
+		unsigned int players = 0;
+		ok = ReadString(file, info.path) && ReadValue(file, info.size) && ReadValue(file, mtime) && ReadValue(file, parsed) &&
+		     ReadValue(file, info.version) && ReadString(file, info.engine) && ReadString(file, info.gameid) &&
+		     ReadValue(file, info.unixtime) && ReadValue(file, info.gametime) && ReadValue(file, info.wallclocktime) &&
+		     ReadValue(file, info.numplayers) && ReadString(file, info.map) && ReadString(file, info.game) && ReadValue(file, players);
+		for (unsigned int p = 0; ok && p < players; p++) {
+			info.players.push_back(std::string());
+			ok = ReadString(file, info.players.back());
+		}
+		ok = ok && ReadString(file, info.script);
+		if (ok) {
+			info.mtime = mtime;
+			info.parsed = parsed != 0;
+			const std::string path = info.path;
+			replays[path] = std::move(info);
+		}
+	}
+	fclose(file);
+	if (!ok) {
+		LslWarning("Invalid replay index %s, ignoring it", cachefile.c_str());
+		return false;
+	}
+	boost::mutex::scoped_lock lock(m_lock);
+	m_replays.swap(replays);
+	return true;
+}
+
+bool ReplayIndex::Save() const
+{
+	boost::mutex::scoped_lock lock(m_lock);
+	if (m_cachefile.empty())
+		return false;
+	const std::string tmp = m_cachefile + ".tmp";
+	FILE* file = Util::lslopen(tmp, "wb");
+	if (file == NULL) {
+		LslWarning("Couldn't write replay index %s", tmp.c_str());
+		return false;
+	}
+	fwrite(REPLAYINDEX_MAGIC, sizeof(REPLAYINDEX_MAGIC), 1, file);
+	WriteValue(file, REPLAYINDEX_VERSION);
+	WriteValue(file, (unsigned int)m_replays.size());
+	for (const auto& it : m_replays) {
+		const ReplayInfo& info = it.second;
+		WriteString(file, info.path);
+		WriteValue(file, info.size);
+		WriteValue(file, (unsigned long long)info.mtime);
+		WriteValue(file, (char)info.parsed);
+		WriteValue(file, info.version);
+		WriteString(file, info.engine);
+		WriteString(file, info.gameid);
+		WriteValue(file, info.unixtime);
+		WriteValue(file, info.gametime);
+		WriteValue(file, info.wallclocktime);
+		WriteValue(file, info.numplayers);
+		WriteString(file, info.map);
+		WriteString(file, info.game);
+		WriteValue(file, (unsigned int)info.players.size());
+		for (const std::string& player : info.players) {
+			WriteString(file, player);
+		}
+		WriteString(file, info.script);
+	}
+	const bool ok = ferror(file) == 0;
+	fclose(file);
+	boost::system::error_code ec;
+	if (ok)
+		boost::filesystem::rename(tmp, m_cachefile, ec);
+	if (!ok || ec) {
+		boost::filesystem::remove(tmp, ec);
+		LslWarning("Couldn't write replay index %s", m_cachefile.c_str());
+		return false;
+	}
+	return true;
+}
+
+} // namespace LSL
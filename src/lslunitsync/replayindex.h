@@ -0,0 +1,87 @@
+/* This file is part of the Springlobby (GPL v2 or later), see COPYING */
+
+#ifndef LSL_HEADERGUARD_REPLAYINDEX_H
+#define LSL_HEADERGUARD_REPLAYINDEX_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <ctime>
+#include <boost/thread/mutex.hpp>
+#include <boost/noncopyable.hpp>
+#include <lslutils/type_forwards.h>
+
+namespace LSL
+{
+
+//! metadata of one replay file
+struct ReplayInfo
+{
+	ReplayInfo()
+	    : size(0)
+	    , mtime(0)
+	    , parsed(false)
+	    , version(0)
+	    , unixtime(0)
+	    , gametime(0)
+	    , wallclocktime(0)
+	    , numplayers(0)
+	{
+	}
+	std::string path;
+	unsigned long long size;
+	time_t mtime;
+	bool parsed; //! false if the header couldn't be read, only path, size and mtime are valid then
+
+	int version;		//! demo file format version
+	std::string engine;     //! engine version string
+	std::string gameid;     //! hex
+	long long unixtime;     //! start of the game
+	int gametime;		//! duration in game seconds
+	int wallclocktime;      //! duration in real seconds
+	int numplayers;		//! players and spectators, from the demo header
+	std::string map;
+	std::string game;
+	StringVector players; //! names of the non-spectating players from the script
+	std::string script;
+};
+
+/** \brief replay metadata cached by path, size and mtime
+ *
+ * Refresh() lists the given directories and reads the header of new or
+ * changed files with a pool of threads, unchanged files are taken from the
+ * previous scan or the cache file. All methods are thread safe, a running
+ * Refresh() doesn't block readers.
+ */
+class ReplayIndex : public boost::noncopyable
+{
+public:
+	ReplayIndex();
+
+	/** loads the index from path (if not already loaded from there),
+	 *  changes are written back to it by Refresh() */
+	void SetCacheFile(const std::string& path);
+
+	//! rescans dirs for files with the given extensions, returns the number of new, changed or removed files
+	size_t Refresh(const StringVector& dirs, const StringVector& extensions, int threads = 0);
+
+	//! all replays of the last Refresh(), sorted by path, the scripts are left empty unless requested
+	std::vector<ReplayInfo> GetReplays(bool scripts = false) const;
+	bool GetReplay(const std::string& path, ReplayInfo& info) const;
+
+	//! reads the header of a single file, info.path, size and mtime have to be set
+	static bool ReadReplayInfo(ReplayInfo& info);
+
+private:
+	bool Load();
+	bool Save() const;
+
+	mutable boost::mutex m_lock;
+	boost::mutex m_refresh_lock; //! only one Refresh() at a time
+	std::map<std::string, ReplayInfo> m_replays;
+	std::string m_cachefile;
+};
+
+} // namespace LSL
+
+#endif // LSL_HEADERGUARD_REPLAYINDEX_H
@@ -56,6 +56,8 @@ FUNC(int, GetMapInfoExPtr, const char*, SpringMapInfo*, int);
 FUNC(void*, GetMinimapPtr, const char*, int);
 FUNC(int, GetInfoMapSizePtr, const char*, const char*, int*, int*);
 FUNC(int, GetInfoMapPtr, const char*, const char*, void*, int);
+FUNC(float, GetMapMinHeightPtr, const char*);
+FUNC(float, GetMapMaxHeightPtr, const char*);
 
 FUNC(unsigned int, GetPrimaryModChecksumPtr, int);
 FUNC(int, GetPrimaryModIndexPtr, const char*);
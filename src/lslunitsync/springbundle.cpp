@@ -4,12 +4,126 @@
 #include "sharedlib.h"
 #include "signatures.h"
 #include <string>
+#include <vector>
+#include <fstream>
+#include <stdio.h>
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 
 #include <lslutils/misc.h>
 
 namespace LSL
 {
 
+//! versions of unitsync libraries by path, valid as long as size and mtime match
+class BundleVersionCache
+{
+public:
+	static BundleVersionCache& Get()
+	{
+		static BundleVersionCache cache;
+		return cache;
+	}
+
+	void SetCacheFile(const std::string& path)
+	{
+		boost::mutex::scoped_lock lock(m_lock);
+		if (m_cachefile == path)
+			return;
+		m_cachefile = path;
+		Load();
+	}
+
+	bool Lookup(const std::string& unitsync, std::string& version)
+	{
+		Entry stat;
+		if (!Stat(unitsync, stat))
+			return false;
+		boost::mutex::scoped_lock lock(m_lock);
+		const auto it = m_entries.find(unitsync);
+		if (it == m_entries.end() || it->second.size != stat.size || it->second.mtime != stat.mtime)
+			return false;
+		version = it->second.version;
+		return true;
+	}
+
+	void Store(const std::string& unitsync, const std::string& version)
+	{
+		Entry entry;
+		if (!Stat(unitsync, entry))
+			return;
+		entry.version = version;
+		boost::mutex::scoped_lock lock(m_lock);
+		m_entries[unitsync] = entry;
+		Save();
+	}
+
+private:
+	struct Entry
+	{
+		Entry()
+		    : size(0)
+		    , mtime(0)
+		{
+		}
+		unsigned long long size;
+		time_t mtime;
+		std::string version;
+	};
+
+	static bool Stat(const std::string& path, Entry& entry)
+	{
+		boost::system::error_code ec;
+		entry.size = boost::filesystem::file_size(path, ec);
+		if (ec)
+			return false;
+		entry.mtime = boost::filesystem::last_write_time(path, ec);
+		return !ec;
+	}
+
+	//! one line per library: size, mtime, path and version separated by tabs
+	void Load()
+	{
+		m_entries.clear();
+		std::ifstream file(m_cachefile.c_str());
+		std::string line;
+		while (std::getline(file, line)) {
+			const StringVector fields = Util::StringTokenize(line, "\t");
+			if (fields.size() != 4)
+				continue;
+			Entry& entry = m_entries[fields[2]];
+			entry.size = strtoull(fields[0].c_str(), NULL, 10);
+			entry.mtime = (time_t)strtoll(fields[1].c_str(), NULL, 10);
+			entry.version = fields[3];
+		}
+	}
+
+	void Save() const
+	{
+		if (m_cachefile.empty())
+			return;
+		FILE* file = Util::lslopen(m_cachefile, "w");
+		if (file == NULL) {
+			LslWarning("Couldn't write %s", m_cachefile.c_str());
+			return;
+		}
+		for (const auto& it : m_entries) {
+			fprintf(file, "%llu\t%lld\t%s\t%s\n", it.second.size, (long long)it.second.mtime, it.first.c_str(), it.second.version.c_str());
+		}
+		fclose(file);
+	}
+
+	boost::mutex m_lock;
+	std::map<std::string, Entry> m_entries;
+	std::string m_cachefile;
+};
+
+void SpringBundle::SetVersionCacheFile(const std::string& path)
+{
+	BundleVersionCache::Get().SetCacheFile(path);
+}
+
 bool SpringBundle::GetBundleVersion()
 {
 	if (!version.empty()) //get version only once
@@ -17,6 +131,8 @@ bool SpringBundle::GetBundleVersion()
 	if (!Util::FileExists(unitsync)) {
 		return false;
 	}
+	if (BundleVersionCache::Get().Lookup(unitsync, version))
+		return !version.empty();
 	void* temphandle = _LoadLibrary(unitsync);
 	std::string functionname = "GetSpringVersion";
 	GetSpringVersionPtr getspringversion = (GetSpringVersionPtr)GetLibFuncPtr(temphandle, functionname);
@@ -37,6 +153,7 @@ bool SpringBundle::GetBundleVersion()
 		version += getspringversionpatcheset();
 	}
 	_FreeLibrary(temphandle);
+	BundleVersionCache::Get().Store(unitsync, version);
 	return !version.empty();
 }
 
@@ -166,12 +283,27 @@ bool SpringBundle::LocateSystemInstalledSpring(LSL::SpringBundle& bundle)
 	AddPath("/lib", paths);
 	AddPath("/bin", paths);
 
-	for (const std::string path : paths) {
-		if (bundle.AutoComplete(path)) {
+	// probe all dirs at once, slow (network) mounts in PATH would add up otherwise
+	std::vector<char> candidates(paths.size(), 0);
+	{
+		boost::thread_group group;
+		for (size_t i = 0; i < paths.size(); i++) {
+			group.create_thread([&paths, &candidates, i]() {
+				SpringBundle probe;
+				const bool found = probe.AutoFindUnitsync(paths[i]) || Util::FileExists(paths[i] + SEP + "spring" + EXEEXT);
+				candidates[i] = found ? 1 : 0;
+			});
+		}
+		group.join_all();
+	}
+
+	for (size_t i = 0; i < paths.size(); i++) {
+		if (candidates[i] && bundle.AutoComplete(paths[i])) {
 			return true;
 		}
 	}
-	return false;
+	// dirs without spring files can't add anything, but the bundle might have been complete already
+	return !paths.empty() && bundle.AutoComplete();
 }
 
 
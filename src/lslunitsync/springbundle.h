@@ -33,6 +33,12 @@ public:
 	 */
 	static std::map<std::string, SpringBundle> GetSpringVersionList(const std::list<SpringBundle>& unitsync_paths);
 	static bool LocateSystemInstalledSpring(LSL::SpringBundle& bundle);
+	/**
+	 * The versions of unitsync libraries are remembered by path, size and
+	 * mtime, so a library is only loaded again when it changed. Setting a
+	 * cache file keeps them across restarts.
+	 */
+	static void SetVersionCacheFile(const std::string& path);
 
 private:
 	bool AutoFindUnitsync(const std::string& unitsyncpath);
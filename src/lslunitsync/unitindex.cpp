@@ -0,0 +1,152 @@
+/* This file is part of the Springlobby (GPL v2 or later), see COPYING */
+
+#include "unitindex.h"
+
+#include <algorithm>
+#include <boost/algorithm/string/case_conv.hpp>
+
+namespace LSL
+{
+
+UnitIndex::UnitIndex()
+{
+}
+
+UnitIndex::UnitIndex(const std::vector<UnitsyncUnit>& units)
+    : m_units(units)
+{
+	const int count = m_units.size();
+	m_lower_names.reserve(count);
+	m_lower_fullnames.reserve(count);
+	m_by_name.reserve(count);
+	m_by_fullname.reserve(count);
+	std::vector<Trigram> trigrams;
+	for (int i = 0; i < count; i++) {
+		m_lower_names.push_back(boost::algorithm::to_lower_copy(m_units[i].name));
+		m_lower_fullnames.push_back(boost::algorithm::to_lower_copy(m_units[i].fullname));
+		m_by_name.push_back(i);
+		m_by_fullname.push_back(i);
+
+		trigrams.clear();
+		AddTrigrams(m_lower_names[i], trigrams);
+		AddTrigrams(m_lower_fullnames[i], trigrams);
+		std::sort(trigrams.begin(), trigrams.end());
+		trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+		for (const Trigram t : trigrams) {
+			m_trigrams[t].push_back(i); // postings stay sorted as i is increasing
+		}
+	}
+	std::sort(m_by_name.begin(), m_by_name.end(), [this](int a, int b) { return m_lower_names[a] < m_lower_names[b]; });
+	std::sort(m_by_fullname.begin(), m_by_fullname.end(), [this](int a, int b) { return m_lower_fullnames[a] < m_lower_fullnames[b]; });
+}
+
+void UnitIndex::AddTrigrams(const std::string& lower, std::vector<Trigram>& out)
+{
+	for (size_t i = 0; i + 2 < lower.size(); i++) {
+		out.push_back(((unsigned char)lower[i] << 16) | ((unsigned char)lower[i + 1] << 8) | (unsigned char)lower[i + 2]);
+	}
+}
+
+size_t UnitIndex::GetMemoryUsage() const
+{
+	size_t ret = 0;
+	for (size_t i = 0; i < m_units.size(); i++) {
+		ret += sizeof(UnitsyncUnit) + 2 * sizeof(std::string) + 2 * sizeof(int);
+		ret += 2 * (m_units[i].name.capacity() + m_units[i].fullname.capacity());
+	}
+	for (const auto& it : m_trigrams) {
+		ret += sizeof(it) + it.second.capacity() * sizeof(int);
+	}
+	return ret;
+}
+
+int UnitIndex::Find(const std::string& unitname) const
+{
+	const std::string lower = boost::algorithm::to_lower_copy(unitname);
+	const auto it = std::lower_bound(m_by_name.begin(), m_by_name.end(), lower,
+					 [this](int pos, const std::string& val) { return m_lower_names[pos] < val; });
+	if (it == m_by_name.end() || m_lower_names[*it] != lower)
+		return -1;
+	return *it;
+}
+
+void UnitIndex::PrefixRange(const std::vector<int>& sorted, const std::vector<std::string>& names,
+			    const std::string& prefix, std::vector<int>& out) const
+{
+	auto it = std::lower_bound(sorted.begin(), sorted.end(), prefix,
+				   [&names](int pos, const std::string& val) { return names[pos] < val; });
+	for (; it != sorted.end(); ++it) {
+		if (names[*it].compare(0, prefix.size(), prefix) != 0)
+			break;
+		out.push_back(*it);
+	}
+}
+
+std::vector<int> UnitIndex::FindPrefix(const std::string& prefix, size_t max) const
+{
+	const std::string lower = boost::algorithm::to_lower_copy(prefix);
+	std::vector<int> ret;
+	PrefixRange(m_by_name, m_lower_names, lower, ret);
+	PrefixRange(m_by_fullname, m_lower_fullnames, lower, ret);
+	std::sort(ret.begin(), ret.end(), [this](int a, int b) { return m_lower_names[a] < m_lower_names[b]; });
+	ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
+	if (max > 0 && ret.size() > max)
+		ret.resize(max);
+	return ret;
+}
+
+std::vector<int> UnitIndex::Search(const std::string& query, size_t max) const
+{
+	const std::string lower = boost::algorithm::to_lower_copy(query);
+	std::vector<int> ret;
+	if (lower.empty())
+		return ret;
+
+	std::vector<Trigram> trigrams;
+	AddTrigrams(lower, trigrams);
+	std::sort(trigrams.begin(), trigrams.end());
+	trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+	// score: 2 per matched trigram, +1 if the query is a substring of one of the names
+	std::vector<int> scores;
+	if (trigrams.empty()) { // too short for trigrams, substring match only
+		scores.assign(m_units.size(), 0);
+		for (size_t i = 0; i < m_units.size(); i++) {
+			if (m_lower_names[i].find(lower) != std::string::npos || m_lower_fullnames[i].find(lower) != std::string::npos) {
+				scores[i] = 1;
+				ret.push_back(i);
+			}
+		}
+	} else {
+		scores.assign(m_units.size(), 0);
+		for (const Trigram t : trigrams) {
+			const auto it = m_trigrams.find(t);
+			if (it == m_trigrams.end())
+				continue;
+			for (const int pos : it->second) {
+				scores[pos] += 2;
+			}
+		}
+		const int needed = 2 * ((trigrams.size() + 1) / 2);
+		for (size_t i = 0; i < m_units.size(); i++) {
+			if (scores[i] < needed)
+				continue;
+			if ((size_t)scores[i] == 2 * trigrams.size() &&
+			    (m_lower_names[i].find(lower) != std::string::npos || m_lower_fullnames[i].find(lower) != std::string::npos)) {
+				scores[i]++;
+			}
+			ret.push_back(i);
+		}
+	}
+
+	std::sort(ret.begin(), ret.end(), [this, &scores](int a, int b) {
+		if (scores[a] != scores[b])
+			return scores[a] > scores[b];
+		return m_lower_names[a] < m_lower_names[b];
+	});
+	if (max > 0 && ret.size() > max)
+		ret.resize(max);
+	return ret;
+}
+
+} // namespace LSL
@@ -0,0 +1,82 @@
+/* This file is part of the Springlobby (GPL v2 or later), see COPYING */
+
+#ifndef LSL_HEADERGUARD_UNITINDEX_H
+#define LSL_HEADERGUARD_UNITINDEX_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace LSL
+{
+
+struct UnitsyncUnit
+{
+	UnitsyncUnit()
+	    : index(-1)
+	{
+	}
+	UnitsyncUnit(const std::string& name, const std::string& fullname, int index)
+	    : name(name)
+	    , fullname(fullname)
+	    , index(index)
+	{
+	}
+	std::string name;     ///< internal unit name, as used in unit restrictions
+	std::string fullname; ///< human readable name
+	int index;	      ///< unitsync index of the unit
+};
+
+/** \brief immutable, searchable table of all units of one game
+ *
+ * All lookups are case insensitive. Results are positions in Units().
+ * Exact and prefix lookups are binary searches over sorted name arrays,
+ * Search() uses a trigram index over internal and full names, so a lookup in a
+ * table with a few thousand units doesn't need to scan all names.
+ */
+class UnitIndex
+{
+public:
+	UnitIndex();
+	explicit UnitIndex(const std::vector<UnitsyncUnit>& units);
+
+	const std::vector<UnitsyncUnit>& Units() const
+	{
+		return m_units;
+	}
+	size_t size() const
+	{
+		return m_units.size();
+	}
+	bool empty() const
+	{
+		return m_units.empty();
+	}
+	//! estimated heap memory used by the table in bytes
+	size_t GetMemoryUsage() const;
+
+	//! position of the unit with the given internal name, -1 if not found
+	int Find(const std::string& unitname) const;
+	//! units whose internal or full name starts with prefix, sorted by internal name
+	std::vector<int> FindPrefix(const std::string& prefix, size_t max = 0) const;
+	/** fuzzy search: units whose names share at least half of the trigrams of query,
+	 *  best matches (containing query as substring, most common trigrams) first */
+	std::vector<int> Search(const std::string& query, size_t max = 0) const;
+
+private:
+	typedef unsigned int Trigram;
+	static void AddTrigrams(const std::string& lower, std::vector<Trigram>& out);
+	void PrefixRange(const std::vector<int>& sorted, const std::vector<std::string>& names,
+			 const std::string& prefix, std::vector<int>& out) const;
+
+	std::vector<UnitsyncUnit> m_units;
+	std::vector<std::string> m_lower_names;
+	std::vector<std::string> m_lower_fullnames;
+	std::vector<int> m_by_name;	//! positions sorted by m_lower_names
+	std::vector<int> m_by_fullname; //! positions sorted by m_lower_fullnames
+	std::unordered_map<Trigram, std::vector<int>> m_trigrams;
+};
+
+} // namespace LSL
+
+#endif // LSL_HEADERGUARD_UNITINDEX_H
@@ -7,6 +7,7 @@
 #include <stdexcept>
 #include <clocale>
 #include <set>
+#include <limits>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/format.hpp>
@@ -16,6 +17,10 @@
 #include "c_api.h"
 #include "image.h"
 #include "springbundle.h"
+#include "unitindex.h"
+#include "maptable.h"
+#include "rawheightmap.h"
+#include "archiveindex.h"
 
 #include <lslutils/config.h>
 #include <lslutils/debug.h>
@@ -23,10 +28,14 @@
 #include <lslutils/misc.h>
 #include <lslutils/globalsmanager.h>
 #include <lslutils/thread.h>
+#include <lslutils/dirwatcher.h>
 
 #define LOCK_UNITSYNC boost::mutex::scoped_lock lock_criticalsection(m_lock)
 
-#define ASYNC_LOAD 0 //FIXME: repair/set to 1!
+// the map and game lists are read from an immutable ArchiveCatalog and are
+// safe during an async reload, callers of ReloadUnitSyncLib() still expect
+// the new lists once it returns
+#define ASYNC_LOAD 0
 #if ASYNC_LOAD
 #define TRY_LOCK(ret)                                               \
 	boost::mutex::scoped_try_lock lock_criticalsection(m_lock); \
@@ -48,14 +57,37 @@ namespace LSL
 {
 
 Unitsync::Unitsync()
-    : m_cache_thread(new WorkerThread)
-    , m_map_image_cache(30, "m_map_image_cache")
+    : m_catalog(new ArchiveCatalog())
+    , m_cache_thread(new WorkerThread)
+    , m_datadir_watcher(NULL)
+    , m_memory_governor(64 * 1024 * 1024)
+    , m_map_image_cache(30, "m_map_image_cache", &m_memory_governor)
     , // may take about 300k per image ( 512x512 24 bpp minimap )
-    m_tiny_minimap_cache(200, "m_tiny_minimap_cache")
+    m_tiny_minimap_cache(200, "m_tiny_minimap_cache", &m_memory_governor)
     , // takes at most 30k per image (   100x100 24 bpp minimap )
-    m_mapinfo_cache(1000000, "m_mapinfo_cache")
+    m_mapsummary_cache(1000000, "m_mapsummary_cache", &m_memory_governor, 4.0)
     ,					// this one is just misused as thread safe std::map ...
-    m_sides_cache(200, "m_sides_cache") // another misuse
+    m_mapinfo_cache(50, "m_mapinfo_cache", &m_memory_governor, 2.0)
+    ,
+    m_sides_cache(200, "m_sides_cache", &m_memory_governor) // another misuse
+    , m_unitindex_cache(20, "m_unitindex_cache", &m_memory_governor, 2.0)
+    , m_sideatlas_cache(20, "m_sideatlas_cache", &m_memory_governor, 2.0)
+    , m_validmaps_cache(50, "m_validmaps_cache", &m_memory_governor, 2.0)
+    , m_aicatalog_cache(20, "m_aicatalog_cache", &m_memory_governor, 2.0)
+    , m_rawheightmap_cache(10, "m_rawheightmap_cache", &m_memory_governor)
+    , m_metalspots_cache(1000, "m_metalspots_cache", &m_memory_governor, 4.0)
+    , m_terrainstats_cache(1000, "m_terrainstats_cache", &m_memory_governor, 4.0)
+    , m_archiveindex_cache(50, "m_archiveindex_cache", &m_memory_governor, 2.0)
+    // options aren't cached on disk, so they are more expensive to get again
+    , m_map_gameoptions(1000, "m_map_gameoptions", &m_memory_governor, 8.0)
+    , m_game_gameoptions(100, "m_game_gameoptions", &m_memory_governor, 8.0)
+    , m_mapinfo_generation(0)
+    , m_map_table_generation(0)
+    , m_map_table_fetched(false)
+    , m_prefetch_maxqueued(2)
+    , m_prefetch_maxmemory(16 * 1024 * 1024)
+    , m_prefetch_epoch(boost::posix_time::microsec_clock::universal_time())
+    , m_user_requests(0)
 {
 }
 
@@ -69,6 +101,8 @@ enum ASYNC_EVENTS {
 
 Unitsync::~Unitsync()
 {
+	StopDataDirWatcher();
+	SetPrefetchBudget(0, 0);
 	ClearCache();
 	delete m_cache_thread;
 	m_cache_thread = NULL;
@@ -93,28 +127,55 @@ bool CompareStringNoCase(const std::string& first, const std::string& second)
 bool Unitsync::LoadUnitSyncLib(const std::string& unitsyncloc)
 {
 	LOCK_UNITSYNC;
-	ClearCache();
+	// readers keep using the old catalog until the new one is complete
+	boost::shared_ptr<const ArchiveCatalog> catalog(new ArchiveCatalog());
 	bool ret = _LoadUnitSyncLib(unitsyncloc);
 	if (ret) {
-		m_cache_path = LSL::Util::config().GetCachePath();
-		PopulateArchiveList();
+		catalog = PopulateArchiveList();
 	}
+	boost::atomic_store(&m_catalog, catalog);
+	ClearCache();
 	return ret;
 }
 
+boost::shared_ptr<const ArchiveCatalog> Unitsync::GetCatalog() const
+{
+	return boost::atomic_load(&m_catalog);
+}
+
 void Unitsync::ClearCache()
 {
-	m_maps_list.clear();
-	m_mods_list.clear();
-	m_mod_array.clear();
-	m_map_array.clear();
-	m_unsorted_mod_array.clear();
-	m_unsorted_map_array.clear();
 	m_map_image_cache.Clear();
+	m_mapsummary_cache.Clear();
 	m_mapinfo_cache.Clear();
 	m_sides_cache.Clear();
-	m_map_gameoptions.clear();
-	m_game_gameoptions.clear();
+	m_unitindex_cache.Clear();
+	m_sideatlas_cache.Clear();
+	m_validmaps_cache.Clear();
+	m_aicatalog_cache.Clear();
+	m_rawheightmap_cache.Clear();
+	m_metalspots_cache.Clear();
+	m_terrainstats_cache.Clear();
+	m_archiveindex_cache.Clear();
+	{
+		boost::mutex::scoped_lock lock(m_aicatalog_lock);
+		m_last_aicatalog.reset();
+	}
+	{
+		boost::mutex::scoped_lock lock(m_maptable_lock);
+		m_map_table.reset();
+		m_mapinfo_generation++; // tables being built are stale
+	}
+	{
+		boost::mutex::scoped_lock lock(m_mapinfo_failed_lock);
+		m_mapinfo_failed.clear();
+	}
+	{
+		boost::mutex::scoped_lock lock(m_prefetch_lock);
+		m_prefetch_done.clear();
+	}
+	m_map_gameoptions.Clear();
+	m_game_gameoptions.Clear();
 }
 
 void Unitsync::FetchUnitsyncErrors(const std::string& prefix)
@@ -141,8 +202,11 @@ static std::string GetGameInfo(int index, const std::string keyname)
 	return "";
 }
 
-void Unitsync::PopulateArchiveList()
+boost::shared_ptr<const ArchiveCatalog> Unitsync::PopulateArchiveList()
 {
+	boost::shared_ptr<ArchiveCatalog> catalog(new ArchiveCatalog());
+	catalog->cache_path = LSL::Util::config().GetCachePath();
+	catalog->engine_version = GetSpringVersion();
 
 	const int numMaps = susynclib().GetMapCount();
 	for (int i = 0; i < numMaps; i++) {
@@ -161,10 +225,10 @@ void Unitsync::PopulateArchiveList()
 		}
 		try {
 			assert(!name.empty());
-			m_maps_list[name] = LSL::Util::ToUIntString(hash);
+			catalog->maps_list[name] = LSL::Util::ToUIntString(hash);
 			if (!archivename.empty())
-				m_maps_archive_name[name] = archivename;
-			m_map_array.push_back(name);
+				catalog->maps_archive_name[name] = archivename;
+			catalog->map_array.push_back(name);
 		} catch (...) {
 			LslError("Found map with hash collision: %s hash: %d", name.c_str(), hash);
 		}
@@ -186,19 +250,20 @@ void Unitsync::PopulateArchiveList()
 		}
 		try {
 			assert(!name.empty());
-			m_mods_list[name] = LSL::Util::ToUIntString(hash);
+			catalog->mods_list[name] = LSL::Util::ToUIntString(hash);
 			if (!archivename.empty())
-				m_mods_archive_name[name] = archivename;
-			m_mod_array.push_back(name);
+				catalog->mods_archive_name[name] = archivename;
+			catalog->mod_array.push_back(name);
 		} catch (...) {
 			LslError("Found game with hash collision: %s hash: %s", name.c_str(), hash);
 		}
 		FetchUnitsyncErrors(name);
 	}
-	m_unsorted_mod_array = m_mod_array;
-	m_unsorted_map_array = m_map_array;
-	std::sort(m_map_array.begin(), m_map_array.end(), &CompareStringNoCase);
-	std::sort(m_mod_array.begin(), m_mod_array.end(), &CompareStringNoCase);
+	catalog->unsorted_mod_array = catalog->mod_array;
+	catalog->unsorted_map_array = catalog->map_array;
+	std::sort(catalog->map_array.begin(), catalog->map_array.end(), &CompareStringNoCase);
+	std::sort(catalog->mod_array.begin(), catalog->mod_array.end(), &CompareStringNoCase);
+	return catalog;
 }
 
 bool Unitsync::_LoadUnitSyncLib(const std::string& unitsyncloc)
@@ -238,17 +303,25 @@ std::string Unitsync::GetSpringVersion() const
 }
 
 
+//! value of key in list, empty if there is none
+static std::string FindValue(const LocalArchivesVector& list, const std::string& key)
+{
+	LocalArchivesVector::const_iterator itor = list.find(key);
+	if (itor == list.end())
+		return std::string();
+	return itor->second;
+}
+
 StringVector Unitsync::GetGameList() const
 {
-	TRY_LOCK(StringVector())
-	return m_mod_array;
+	return GetCatalog()->mod_array;
 }
 
 bool Unitsync::GameExists(const std::string& gamename, const std::string& hash) const
 {
-	TRY_LOCK(false)
-	LocalArchivesVector::const_iterator itor = m_mods_list.find(gamename);
-	if (itor == m_mods_list.end())
+	const boost::shared_ptr<const ArchiveCatalog> catalog = GetCatalog();
+	LocalArchivesVector::const_iterator itor = catalog->mods_list.find(gamename);
+	if (itor == catalog->mods_list.end())
 		return false;
 	if (hash.empty() || hash == "0")
 		return true;
@@ -258,9 +331,8 @@ bool Unitsync::GameExists(const std::string& gamename, const std::string& hash)
 UnitsyncGame Unitsync::GetGame(const std::string& gamename)
 {
 	UnitsyncGame m;
-	TRY_LOCK(m);
 	m.name = gamename;
-	m.hash = m_mods_list[gamename];
+	m.hash = FindValue(GetCatalog()->mods_list, gamename);
 	return m;
 }
 
@@ -268,50 +340,71 @@ UnitsyncGame Unitsync::GetGame(const std::string& gamename)
 UnitsyncGame Unitsync::GetGame(int index)
 {
 	UnitsyncGame m;
-	TRY_LOCK(m);
-	m.name = m_mod_array[index];
-	m.hash = m_mods_list[m.name];
+	const boost::shared_ptr<const ArchiveCatalog> catalog = GetCatalog();
+	if (index < 0 || index >= (int)catalog->mod_array.size())
+		return m;
+	m.name = catalog->mod_array[index];
+	m.hash = FindValue(catalog->mods_list, m.name);
 	return m;
 }
 
 StringVector Unitsync::GetMapList() const
 {
-	TRY_LOCK(StringVector())
-	return m_map_array;
+	return GetCatalog()->map_array;
 }
 
-StringVector Unitsync::GetGameValidMapList(const std::string& gamename) const
+StringVector Unitsync::GetGameValidMapList(const std::string& gamename)
 {
 	StringVector ret;
 	TRY_LOCK(ret)
+	if (gamename.empty())
+		return ret;
+	const std::string cachefile = GetFileCachePath(gamename, true) + ".validmaps";
+	if (m_validmaps_cache.TryGet(cachefile, ret) || GetCacheFile(cachefile, ret)) {
+		m_validmaps_cache.Add(cachefile, ret);
+		return ret;
+	}
 	try {
 		unsigned int mapcount = susynclib().GetValidMapCount(gamename);
 		for (unsigned int i = 0; i < mapcount; i++)
 			ret.push_back(susynclib().GetValidMapName(i));
 	} catch (Exceptions::unitsync& e) {
+		return ret; // don't cache errors
+	}
+	m_validmaps_cache.Add(cachefile, ret);
+	try {
+		SetCacheFile(cachefile, ret);
+	} catch (std::exception& e) {
+		LslWarning("Couldn't write %s: %s", cachefile.c_str(), e.what());
 	}
 	return ret;
 }
 
 bool Unitsync::MapExists(const std::string& mapname, const std::string& hash) const
 {
-	TRY_LOCK(false)
-	LocalArchivesVector::const_iterator itor = m_maps_list.find(mapname);
-	if (itor == m_maps_list.end())
+	const boost::shared_ptr<const ArchiveCatalog> catalog = GetCatalog();
+	LocalArchivesVector::const_iterator itor = catalog->maps_list.find(mapname);
+	if (itor == catalog->maps_list.end())
 		return false;
 	if (hash.empty() || hash == "0")
 		return true;
 	return itor->second == hash;
 }
 
+std::string Unitsync::GetMapHash(const std::string& mapname) const
+{
+	return FindValue(GetCatalog()->maps_list, mapname);
+}
+
 UnitsyncMap Unitsync::GetMap(int index)
 {
 	UnitsyncMap m;
 	TRY_LOCK(m)
-	if (index < 0)
+	const boost::shared_ptr<const ArchiveCatalog> catalog = GetCatalog();
+	if (index < 0 || index >= (int)catalog->map_array.size())
 		return m;
-	m.name = m_map_array[index];
-	m.hash = m_maps_list[m.name];
+	m.name = catalog->map_array[index];
+	m.hash = FindValue(catalog->maps_list, m.name);
 	m.info = _GetMapInfoEx(m.name);
 	return m;
 }
@@ -357,6 +450,45 @@ void GetOptionEntry(const int i, GameOptions& ret)
 	}
 }
 
+static size_t StringMemoryUsage(const std::string& str)
+{
+	return sizeof(std::string) + str.capacity();
+}
+
+//! heap memory of the strings, the objects themselves are part of sizeof(option)
+static size_t OptionMemoryUsage(const mmOptionModel& opt)
+{
+	return opt.name.capacity() + opt.key.capacity() + opt.description.capacity() + opt.section.capacity() + opt.ct_type_string.capacity();
+}
+
+size_t GameOptions::GetMemoryUsage() const
+{
+	// per std::map node overhead
+	const size_t node = 4 * sizeof(void*);
+	size_t ret = 0;
+	for (const auto& it : bool_map) {
+		ret += node + StringMemoryUsage(it.first) + sizeof(it.second) + OptionMemoryUsage(it.second);
+	}
+	for (const auto& it : float_map) {
+		ret += node + StringMemoryUsage(it.first) + sizeof(it.second) + OptionMemoryUsage(it.second);
+	}
+	for (const auto& it : string_map) {
+		ret += node + StringMemoryUsage(it.first) + sizeof(it.second) + OptionMemoryUsage(it.second) + it.second.def.capacity() + it.second.value.capacity();
+	}
+	for (const auto& it : list_map) {
+		ret += node + StringMemoryUsage(it.first) + sizeof(it.second) + OptionMemoryUsage(it.second) + it.second.def.capacity() + it.second.value.capacity();
+		for (const listItem& item : it.second.listitems) {
+			ret += sizeof(listItem) + item.key.capacity() + item.name.capacity() + item.desc.capacity();
+		}
+		for (const std::string& choice : it.second.cbx_choices) {
+			ret += StringMemoryUsage(choice);
+		}
+	}
+	for (const auto& it : section_map) {
+		ret += node + StringMemoryUsage(it.first) + sizeof(it.second) + OptionMemoryUsage(it.second);
+	}
+	return ret;
+}
 
 GameOptions Unitsync::GetMapOptions(const std::string& name)
 {
@@ -364,15 +496,15 @@ GameOptions Unitsync::GetMapOptions(const std::string& name)
 	TRY_LOCK(ret)
 
 	assert(!name.empty());
-	if (m_map_gameoptions.find(name) != m_map_gameoptions.end()) {
-		return m_map_gameoptions[name];
+	if (m_map_gameoptions.TryGet(name, ret)) {
+		return ret;
 	}
 
 	int count = susynclib().GetMapOptionCount(name);
 	for (int i = 0; i < count; ++i) {
 		GetOptionEntry(i, ret);
 	}
-	m_map_gameoptions[name] = ret;
+	m_map_gameoptions.Add(name, ret);
 	return ret;
 }
 
@@ -381,7 +513,7 @@ StringVector Unitsync::GetMapDeps(const std::string& mapname)
 	assert(!mapname.empty());
 	StringVector ret;
 	try {
-		ret = susynclib().GetMapDeps(Util::IndexInSequence(m_unsorted_map_array, mapname));
+		ret = susynclib().GetMapDeps(Util::IndexInSequence(GetCatalog()->unsorted_map_array, mapname));
 	} catch (Exceptions::unitsync& u) {
 	}
 	return ret;
@@ -390,13 +522,14 @@ StringVector Unitsync::GetMapDeps(const std::string& mapname)
 UnitsyncMap Unitsync::GetMap(const std::string& mapname)
 {
 	assert(!mapname.empty());
-	const int i = Util::IndexInSequence(m_map_array, mapname);
+	const boost::shared_ptr<const ArchiveCatalog> catalog = GetCatalog();
+	const int i = Util::IndexInSequence(catalog->map_array, mapname);
 	UnitsyncMap m;
 	if (i < 0) {
 		LSL_THROWF(unitsync, "Map does not exist: %s", mapname.c_str());
 	}
-	m.name = m_map_array[i];
-	m.hash = m_maps_list[m.name];
+	m.name = catalog->map_array[i];
+	m.hash = FindValue(catalog->maps_list, m.name);
 	m.info = _GetMapInfoEx(m.name);
 	return m;
 }
@@ -406,8 +539,8 @@ GameOptions Unitsync::GetGameOptions(const std::string& name)
 	assert(!name.empty());
 	GameOptions ret;
 	TRY_LOCK(ret)
-	if (m_game_gameoptions.find(name) != m_game_gameoptions.end()) {
-		return m_game_gameoptions[name];
+	if (m_game_gameoptions.TryGet(name, ret)) {
+		return ret;
 	}
 	if (!IsLoaded())
 		return ret;
@@ -415,7 +548,7 @@ GameOptions Unitsync::GetGameOptions(const std::string& name)
 	for (int i = 0; i < count; ++i) {
 		GetOptionEntry(i, ret);
 	}
-	m_game_gameoptions[name] = ret;
+	m_game_gameoptions.Add(name, ret);
 	return ret;
 }
 
@@ -425,7 +558,7 @@ StringVector Unitsync::GetGameDeps(const std::string& gamename) const
 	StringVector ret;
 	TRY_LOCK(ret)
 	try {
-		ret = susynclib().GetModDeps(Util::IndexInSequence(m_unsorted_mod_array, gamename));
+		ret = susynclib().GetModDeps(Util::IndexInSequence(GetCatalog()->unsorted_mod_array, gamename));
 	} catch (Exceptions::unitsync& u) {
 	}
 	return ret;
@@ -455,38 +588,169 @@ StringVector Unitsync::GetSides(const std::string& gamename)
 }
 
 
+UnitsyncImage SideAtlas::GetSidePicture(const std::string& sidename) const
+{
+	const auto it = sides.find(boost::to_lower_copy(sidename));
+	if (it == sides.end() || !image.isValid())
+		return UnitsyncImage();
+	return image.Crop(it->second.x, it->second.y, it->second.width, it->second.height);
+}
+
+size_t SideAtlas::GetMemoryUsage() const
+{
+	size_t ret = image.GetMemoryUsage();
+	for (const auto& it : sides) {
+		ret += 4 * sizeof(void*) + StringMemoryUsage(it.first) + sizeof(it.second);
+	}
+	for (const std::string& name : missing) {
+		ret += 4 * sizeof(void*) + StringMemoryUsage(name);
+	}
+	return ret;
+}
+
+UnitsyncImage Unitsync::LoadSidePicture(const std::string& gamename, const std::string& sidename) const
+{
+	const std::string imgname = "SidePics/" + boost::to_lower_copy(sidename);
+	UnitsyncImage img;
+	try {
+		img = GetImage(gamename, imgname + ".png", false);
+	} catch (Exceptions::unitsync& u) {
+	}
+	if (!img.isValid()) {
+		try {
+			img = GetImage(gamename, imgname + ".bmp", true);
+		} catch (Exceptions::unitsync& u) {
+		}
+	}
+	return img;
+}
+
 UnitsyncImage Unitsync::GetSidePicture(const std::string& gamename, const std::string& SideName)
 {
 	assert(!gamename.empty());
 
-	const std::string cachepath = GetFileCachePath(gamename, true, false) + "-side-" + SideName + ".png";
 	UnitsyncImage img;
 	TRY_LOCK(img);
 
-	if (Util::FileExists(cachepath)) {
-		img = UnitsyncImage(cachepath);
-	}
+	const boost::shared_ptr<const SideAtlas> atlas = GetSideAtlas(gamename);
+	img = atlas->GetSidePicture(SideName);
+	if (img.isValid() || atlas->missing.count(boost::to_lower_copy(SideName)) > 0)
+		return img;
 
+	// side isn't listed by GetSides(), look it up on its own
+	const std::string cachepath = GetFileCachePath(gamename, true) + "-side-" + SideName + ".png";
+	const std::string cachefile = FindCacheFile(cachepath);
+	if (Util::FileExists(cachefile)) {
+		img = UnitsyncImage(cachefile);
+	}
 	if (!img.isValid()) { //image seems invalid, recreate
-		std::string ImgName("SidePics");
-		ImgName += "/";
-		ImgName += boost::to_lower_copy(SideName);
-		try {
-			img = GetImage(gamename, ImgName + ".png", false);
-		} catch (Exceptions::unitsync& u) {
+		img = LoadSidePicture(gamename, SideName);
+		if (img.isValid()) {
+			img.Save(cachepath);
 		}
-		if (!img.isValid()) {
-			try {
-				img = GetImage(gamename, ImgName + ".bmp", true);
-			} catch (Exceptions::unitsync& u) {
+	}
+	return img;
+}
+
+//! first line of the atlas table, change it when the format changes
+static const char SIDEATLAS_VERSION[] = "sideatlas 2";
+
+boost::shared_ptr<const SideAtlas> Unitsync::GetSideAtlas(const std::string& gamename)
+{
+	assert(!gamename.empty());
+	// the table has one "side\tx\ty\twidth\theight" line per side after the version,
+	// sides without a picture are a line with only their name.
+	// An atlas without any picture is only kept in memory and extracted again after a restart.
+	const std::string tablefile = GetFileCachePath(gamename, true) + ".sideatlas";
+	boost::shared_ptr<const SideAtlas> cached;
+	if (m_sideatlas_cache.TryGet(tablefile, cached)) {
+		return cached;
+	}
+
+	const std::string imagefile = GetFileCachePath(gamename, true) + ".sideatlas.png";
+	boost::shared_ptr<SideAtlas> atlas(new SideAtlas());
+	StringVector table;
+	bool loaded = GetCacheFile(tablefile, table) && !table.empty() && table[0] == SIDEATLAS_VERSION;
+	if (loaded) {
+		for (size_t i = 1; i < table.size(); i++) {
+			const StringVector fields = Util::StringTokenize(table[i], "\t");
+			if (fields.size() == 1) {
+				atlas->missing.insert(fields[0]);
+				continue;
 			}
+			if (fields.size() != 5)
+				continue;
+			SideAtlas::Rect& rect = atlas->sides[fields[0]];
+			rect.x = Util::FromIntString(fields[1]);
+			rect.y = Util::FromIntString(fields[2]);
+			rect.width = Util::FromIntString(fields[3]);
+			rect.height = Util::FromIntString(fields[4]);
+		}
+		loaded = false;
+		if (!atlas->sides.empty()) {
+			const std::string found = FindCacheFile(imagefile);
+			if (Util::FileExists(found))
+				atlas->image = UnitsyncImage(found);
+			loaded = atlas->image.isValid();
 		}
+	}
 
-		if (img.isValid()) {
-			img.Save(cachepath);
+	if (!loaded) {
+		// extract all pictures at once and put them side by side
+		atlas->sides.clear();
+		atlas->missing.clear();
+		std::vector<std::pair<std::string, UnitsyncImage>> pictures;
+		int width = 0;
+		int height = 0;
+		const StringVector sides = GetSides(gamename);
+		if (sides.empty()) { // GetSides() failed, try again next time
+			return atlas;
+		}
+		for (const std::string& side : sides) {
+			const std::string name = boost::to_lower_copy(side);
+			if (atlas->sides.find(name) != atlas->sides.end() || atlas->missing.count(name) > 0)
+				continue;
+			UnitsyncImage img = LoadSidePicture(gamename, side);
+			if (!img.isValid()) {
+				atlas->missing.insert(name);
+				continue;
+			}
+			SideAtlas::Rect& rect = atlas->sides[name];
+			rect.x = width;
+			rect.y = 0;
+			rect.width = img.GetWidth();
+			rect.height = img.GetHeight();
+			width += rect.width;
+			height = std::max(height, rect.height);
+			pictures.push_back(std::make_pair(name, img));
+		}
+		if (pictures.empty()) { // the game has no side pictures
+			m_sideatlas_cache.Add(tablefile, atlas);
+			return atlas;
+		}
+		table.clear();
+		table.push_back(SIDEATLAS_VERSION);
+		atlas->image = UnitsyncImage(width, height);
+		for (const auto& picture : pictures) {
+			const SideAtlas::Rect& rect = atlas->sides[picture.first];
+			atlas->image.Paste(picture.second, rect.x, rect.y);
+			table.push_back(picture.first + "\t" + Util::ToIntString(rect.x) + "\t" + Util::ToIntString(rect.y) + "\t" +
+					Util::ToIntString(rect.width) + "\t" + Util::ToIntString(rect.height));
+		}
+		for (const std::string& name : atlas->missing) {
+			table.push_back(name);
+		}
+		// the table is only valid with its image
+		if (atlas->image.Save(imagefile)) {
+			try {
+				SetCacheFile(tablefile, table);
+			} catch (std::exception& e) {
+				LslWarning("Couldn't write %s: %s", tablefile.c_str(), e.what());
+			}
 		}
 	}
-	return img;
+	m_sideatlas_cache.Add(tablefile, atlas);
+	return atlas;
 }
 
 UnitsyncImage Unitsync::GetImage(const std::string& gamename, const std::string& image_path, bool useWhiteAsTransparent) const
@@ -506,15 +770,133 @@ UnitsyncImage Unitsync::GetImage(const std::string& gamename, const std::string&
 	return UnitsyncImage::FromVfsFileData(FileContent, FileSize, image_path, useWhiteAsTransparent);
 }
 
-StringVector Unitsync::GetAIList(const std::string& gamename) const
+StringVector Unitsync::GetAIList(const std::string& gamename)
 {
 	StringVector ret;
 	TRY_LOCK(ret);
 	if (gamename.empty())
 		return ret;
-	int total = susynclib().GetSkirmishAICount(gamename);
-	for (int i = 0; i < total; i++) {
-		StringVector infos = susynclib().GetAIInfo(i);
+	const boost::shared_ptr<const AICatalog> catalog = GetAICatalog(gamename);
+	{
+		boost::mutex::scoped_lock lock(m_aicatalog_lock);
+		m_last_aicatalog = catalog;
+	}
+	return catalog->names;
+}
+
+//! cache file escaping, values may contain tabs and newlines
+static std::string EscapeCacheField(const std::string& str)
+{
+	std::string ret;
+	ret.reserve(str.size());
+	for (const char c : str) {
+		switch (c) {
+			case '\\':
+				ret += "\\\\";
+				break;
+			case '\t':
+				ret += "\\t";
+				break;
+			case '\n':
+				ret += "\\n";
+				break;
+			case '\r':
+				ret += "\\r";
+				break;
+			default:
+				ret += c;
+		}
+	}
+	return ret;
+}
+
+static std::string UnescapeCacheField(const std::string& str)
+{
+	std::string ret;
+	ret.reserve(str.size());
+	for (size_t i = 0; i < str.size(); i++) {
+		if (str[i] != '\\' || i + 1 == str.size()) {
+			ret += str[i];
+			continue;
+		}
+		switch (str[++i]) {
+			case 't':
+				ret += '\t';
+				break;
+			case 'n':
+				ret += '\n';
+				break;
+			case 'r':
+				ret += '\r';
+				break;
+			default:
+				ret += str[i];
+		}
+	}
+	return ret;
+}
+
+size_t AICatalog::GetMemoryUsage() const
+{
+	// the vector objects themselves are part of sizeof(AICatalog) and of the infos capacity
+	const CacheMemoryCost<StringVector> cost;
+	size_t ret = cost(names) - sizeof(names) + infos.capacity() * sizeof(StringVector);
+	for (const StringVector& info : infos) {
+		ret += cost(info) - sizeof(info);
+	}
+	return ret;
+}
+
+boost::shared_ptr<const AICatalog> Unitsync::GetAICatalog(const std::string& gamename)
+{
+	assert(!gamename.empty());
+	// skirmish AIs come with the engine, lua AIs with the game
+	std::string engine = GetCatalog()->engine_version;
+	for (char& c : engine) {
+		if (!isalnum((unsigned char)c) && c != '.' && c != '-')
+			c = '_';
+	}
+	// cache file: "ai" line per AI followed by its "key\tvalue\tdescription" lines
+	const std::string cachefile = GetFileCachePath(gamename, true) + "-" + engine + ".ais";
+	boost::shared_ptr<const AICatalog> cached;
+	if (m_aicatalog_cache.TryGet(cachefile, cached)) {
+		return cached;
+	}
+
+	boost::shared_ptr<AICatalog> catalog(new AICatalog());
+	StringVector cache;
+	if (GetCacheFile(cachefile, cache)) {
+		for (const std::string& line : cache) {
+			if (line == "ai") {
+				catalog->infos.push_back(StringVector());
+				continue;
+			}
+			if (catalog->infos.empty())
+				continue;
+			StringVector fields;
+			boost::algorithm::split(fields, line, boost::algorithm::is_any_of("\t"));
+			for (const std::string& field : fields) {
+				catalog->infos.back().push_back(UnescapeCacheField(field));
+			}
+		}
+	} else {
+		const int total = susynclib().GetSkirmishAICount(gamename);
+		for (int i = 0; i < total; i++) {
+			catalog->infos.push_back(susynclib().GetAIInfo(i));
+			const StringVector& infos = catalog->infos.back();
+			cache.push_back("ai");
+			for (size_t j = 0; j + 2 < infos.size(); j += 3) {
+				cache.push_back(EscapeCacheField(infos[j]) + "\t" + EscapeCacheField(infos[j + 1]) + "\t" + EscapeCacheField(infos[j + 2]));
+			}
+		}
+		try {
+			SetCacheFile(cachefile, cache);
+		} catch (std::exception& e) {
+			LslWarning("Couldn't write %s: %s", cachefile.c_str(), e.what());
+		}
+	}
+
+	for (const StringVector& infos : catalog->infos) {
 		const int namepos = Util::IndexInSequence(infos, "shortName");
 		const int versionpos = Util::IndexInSequence(infos, "version");
 		std::string ainame;
@@ -522,9 +904,10 @@ StringVector Unitsync::GetAIList(const std::string& gamename) const
 			ainame += infos[namepos + 1];
 		if (versionpos != lslNotFound)
 			ainame += " " + infos[versionpos + 1];
-		ret.push_back(ainame);
+		catalog->names.push_back(ainame);
 	}
-	return ret;
+	m_aicatalog_cache.Add(cachefile, catalog);
+	return catalog;
 }
 
 void Unitsync::UnSetCurrentArchive()
@@ -538,10 +921,20 @@ void Unitsync::UnSetCurrentArchive()
 	}
 }
 
-StringVector Unitsync::GetAIInfos(int index) const
+StringVector Unitsync::GetAIInfos(int index)
 {
 	StringVector ret;
 	TRY_LOCK(ret);
+	boost::shared_ptr<const AICatalog> catalog;
+	{
+		boost::mutex::scoped_lock lock(m_aicatalog_lock);
+		catalog = m_last_aicatalog;
+	}
+	if (catalog) {
+		if (index >= 0 && index < (int)catalog->infos.size())
+			ret = catalog->infos[index];
+		return ret;
+	}
 	try {
 		ret = susynclib().GetAIInfo(index);
 	} catch (std::runtime_error) {
@@ -549,6 +942,18 @@ StringVector Unitsync::GetAIInfos(int index) const
 	return ret;
 }
 
+StringVector Unitsync::GetAIInfos(const std::string& gamename, int index)
+{
+	StringVector ret;
+	TRY_LOCK(ret);
+	if (gamename.empty())
+		return ret;
+	const boost::shared_ptr<const AICatalog> catalog = GetAICatalog(gamename);
+	if (index >= 0 && index < (int)catalog->infos.size())
+		ret = catalog->infos[index];
+	return ret;
+}
+
 GameOptions Unitsync::GetAIOptions(const std::string& gamename, int index)
 {
 	assert(!gamename.empty());
@@ -562,23 +967,50 @@ GameOptions Unitsync::GetAIOptions(const std::string& gamename, int index)
 }
 
 StringVector Unitsync::GetUnitsList(const std::string& gamename)
+{
+	StringVector ret;
+	TRY_LOCK(ret)
+	const boost::shared_ptr<const UnitIndex> index = GetUnitIndex(gamename);
+	ret.reserve(index->size());
+	for (const UnitsyncUnit& unit : index->Units()) {
+		ret.push_back(unit.fullname + " (" + unit.name + ")");
+	}
+	return ret;
+}
+
+boost::shared_ptr<const UnitIndex> Unitsync::GetUnitIndex(const std::string& gamename)
 {
 	assert(!gamename.empty());
-	const std::string cachefile = GetFileCachePath(gamename, true) + ".units";
-	StringVector cache;
-	TRY_LOCK(cache)
+	// cache file contains one "unitname\tfull name" line per unit, in unitsync order
+	const std::string cachefile = GetFileCachePath(gamename, true) + ".unitdb";
+	boost::shared_ptr<const UnitIndex> index;
+	if (m_unitindex_cache.TryGet(cachefile, index)) {
+		return index;
+	}
 
-	if (!GetCacheFile(cachefile, cache)) { //cache read failed
+	std::vector<UnitsyncUnit> units;
+	StringVector cache;
+	if (GetCacheFile(cachefile, cache)) {
+		units.reserve(cache.size());
+		for (const std::string& line : cache) {
+			units.push_back(UnitsyncUnit(Util::BeforeFirst(line, "\t"), Util::AfterFirst(line, "\t"), units.size()));
+		}
+	} else {
 		susynclib().SetCurrentMod(gamename);
 		while (susynclib().ProcessUnitsNoChecksum() > 0) {
 		}
 		const int unitcount = susynclib().GetUnitCount();
+		units.reserve(unitcount);
+		cache.reserve(unitcount);
 		for (int i = 0; i < unitcount; i++) {
-			cache.push_back(susynclib().GetFullUnitName(i) + " (" + susynclib().GetUnitName(i) + ")");
+			units.push_back(UnitsyncUnit(susynclib().GetUnitName(i), susynclib().GetFullUnitName(i), i));
+			cache.push_back(units.back().name + "\t" + units.back().fullname);
 		}
 		SetCacheFile(cachefile, cache);
 	}
-	return cache;
+	index.reset(new UnitIndex(units));
+	m_unitindex_cache.Add(cachefile, index);
+	return index;
 }
 
 UnitsyncImage Unitsync::GetMinimap(const std::string& mapname)
@@ -610,7 +1042,7 @@ UnitsyncImage Unitsync::GetMinimap(const std::string& mapname, int width, int he
 	// and we need to resize it to the correct aspect ratio.
 	if (img.isValid()) {
 		try {
-			MapInfo mapinfo = _GetMapInfoEx(mapname);
+			const MapSummary mapinfo = GetMapSummary(mapname);
 
 			lslSize image_size = lslSize(mapinfo.width, mapinfo.height).MakeFit(lslSize(width, height));
 			img.Rescale(image_size.GetWidth(), image_size.GetHeight());
@@ -625,6 +1057,81 @@ UnitsyncImage Unitsync::GetMinimap(const std::string& mapname, int width, int he
 	return img;
 }
 
+UnitsyncImage Unitsync::GetMapPreview(const std::string& mapname, int width, int height, int layers)
+{
+	MapInfo info;
+	try {
+		info = _GetMapInfoEx(mapname);
+	} catch (std::exception& e) {
+		LslWarning("Couldn't get preview of %s: %s", mapname.c_str(), e.what());
+		return UnitsyncImage(1, 1);
+	}
+	const lslSize size = lslSize(info.width, info.height).MakeFit(lslSize(width, height));
+	if (size.GetWidth() <= 0 || size.GetHeight() <= 0)
+		return UnitsyncImage(1, 1);
+	const std::string cachefile = GetFileCachePath(mapname, false) + (boost::format(".preview-%dx%d-%d.png") % size.GetWidth() % size.GetHeight() % layers).str();
+	UnitsyncImage img;
+	if (m_map_image_cache.TryGet(cachefile, img)) {
+		return img;
+	}
+	const std::string found = FindCacheFile(cachefile);
+	if (Util::FileExists(found)) {
+		img = UnitsyncImage(found);
+		if (img.isValid()) {
+			m_map_image_cache.Add(cachefile, img);
+			return img;
+		}
+	}
+
+	// the sources stay unscaled, ComposeMapPreview() samples them for each preview pixel.
+	// Without every requested layer the preview isn't cached, unitsync may only have failed for now
+	MapPreviewSources src;
+	bool complete = true;
+	std::vector<unsigned char> minimap;
+	if (layers & PREVIEW_MINIMAP) {
+		const UnitsyncImage image = GetMinimap(mapname);
+		// GetMinimap() returns a 1x1 dummy if it failed
+		if (image.isValid() && (image.GetWidth() > 1 || image.GetHeight() > 1))
+			minimap = image.GetRGBData();
+		complete = complete && !minimap.empty();
+		if (!minimap.empty()) {
+			src.minimap = &minimap[0];
+			src.minimapWidth = image.GetWidth();
+			src.minimapHeight = image.GetHeight();
+		}
+	}
+	std::vector<unsigned char> metal;
+	if (layers & PREVIEW_METAL) {
+		try {
+			susynclib().GetMetalmapData(mapname, metal, src.metalWidth, src.metalHeight);
+			src.metal = &metal[0];
+		} catch (std::exception& e) {
+			LslWarning("Couldn't get metalmap of %s: %s", mapname.c_str(), e.what());
+			complete = false;
+		}
+	}
+	boost::shared_ptr<const RawHeightmap> heightmap;
+	if (layers & PREVIEW_HEIGHT) {
+		heightmap = GetRawHeightmap(mapname);
+		complete = complete && heightmap->isValid();
+		src.heights = heightmap->GetData();
+		src.heightsWidth = heightmap->GetWidth();
+		src.heightsHeight = heightmap->GetHeight();
+	}
+	src.positions = info.positions;
+	src.mapWidth = info.width;
+	src.mapHeight = info.height;
+
+	std::vector<unsigned char> rgb(3 * size.GetWidth() * size.GetHeight());
+	ComposeMapPreview(src, layers, size.GetWidth(), size.GetHeight(), &rgb[0]);
+	img = UnitsyncImage::FromRGBData(&rgb[0], size.GetWidth(), size.GetHeight());
+	if (complete) {
+		img.Save(cachefile);
+		m_map_image_cache.Add(cachefile, img);
+	}
+	return img;
+}
+
 UnitsyncImage Unitsync::GetMetalmap(const std::string& mapname)
 {
 	return _GetMapImage(mapname, ".metalmap.png", &UnitsyncLib::GetMetalmap);
@@ -647,6 +1154,163 @@ UnitsyncImage Unitsync::GetHeightmap(const std::string& mapname, int width, int
 	return _GetScaledMapImage(mapname, &Unitsync::GetHeightmap, width, height);
 }
 
+boost::shared_ptr<const RawHeightmap> Unitsync::GetRawHeightmap(const std::string& mapname)
+{
+	return _GetRawHeightmap(mapname, true);
+}
+
+boost::shared_ptr<const RawHeightmap> Unitsync::_GetRawHeightmap(const std::string& mapname, bool persist)
+{
+	const std::string cachefile = GetFileCachePath(mapname, false) + ".heightmap.raw";
+	boost::shared_ptr<const RawHeightmap> cached;
+	if (m_rawheightmap_cache.TryGet(cachefile, cached)) {
+		return cached;
+	}
+
+	boost::shared_ptr<RawHeightmap> heightmap(new RawHeightmap());
+	const std::string found = FindCacheFile(cachefile);
+	if (Util::FileExists(found) && heightmap->Load(found)) {
+		m_rawheightmap_cache.Add(cachefile, heightmap);
+		return heightmap;
+	}
+
+	try {
+		std::vector<unsigned short> data;
+		int width = 0;
+		int height = 0;
+		susynclib().GetHeightmapData(mapname, data, width, height);
+		heightmap.reset(new RawHeightmap(width, height, data));
+	} catch (std::exception& e) {
+		LslWarning("Couldn't get heightmap of %s: %s", mapname.c_str(), e.what());
+		return heightmap;
+	}
+	if (!persist)
+		return heightmap;
+	if (!heightmap->Save(cachefile)) {
+		LslWarning("Couldn't write %s", cachefile.c_str());
+	}
+	m_rawheightmap_cache.Add(cachefile, heightmap);
+	return heightmap;
+}
+
+//! first line of the metal spot cache file, change it when the format or the threshold changes
+static const char METALSPOTS_VERSION[] = "metalspots 2";
+
+std::vector<MetalSpot> Unitsync::GetMetalSpots(const std::string& mapname)
+{
+	// one "x\tz\tmetal\tpixels" line per spot after the version
+	const std::string cachefile = GetFileCachePath(mapname, false) + ".metalspots";
+	std::vector<MetalSpot> spots;
+	if (m_metalspots_cache.TryGet(cachefile, spots)) {
+		return spots;
+	}
+
+	StringVector cache;
+	if (GetCacheFile(cachefile, cache) && !cache.empty() && cache[0] == METALSPOTS_VERSION) {
+		for (size_t i = 1; i < cache.size(); i++) {
+			const StringVector fields = Util::StringTokenize(cache[i], "\t");
+			if (fields.size() != 4)
+				continue;
+			MetalSpot spot;
+			spot.x = Util::FromFloatString(fields[0]);
+			spot.z = Util::FromFloatString(fields[1]);
+			spot.metal = Util::FromFloatString(fields[2]);
+			spot.pixels = Util::FromIntString(fields[3]);
+			spots.push_back(spot);
+		}
+		m_metalspots_cache.Add(cachefile, spots);
+		return spots;
+	}
+
+	try {
+		std::vector<unsigned char> data;
+		int width = 0;
+		int height = 0;
+		susynclib().GetMetalmapData(mapname, data, width, height);
+		const MapSummary summary = GetMapSummary(mapname);
+		// the metal map has half the resolution of the heightmap, 16 map units per pixel
+		const float scale = (summary.width > 1) ? float(summary.width) / width : 16.0f;
+		const unsigned char threshold = MetalSpotThreshold(&data[0], data.size());
+		spots = FindMetalSpots(&data[0], width, height, threshold, scale, summary.maxMetal);
+	} catch (std::exception& e) {
+		LslWarning("Couldn't get metal spots of %s: %s", mapname.c_str(), e.what());
+		return spots;
+	}
+
+	cache.clear();
+	cache.push_back(METALSPOTS_VERSION);
+	for (const MetalSpot& spot : spots) {
+		cache.push_back(Util::ToFloatString(spot.x) + "\t" + Util::ToFloatString(spot.z) + "\t" +
+				Util::ToFloatString(spot.metal) + "\t" + Util::ToIntString(spot.pixels));
+	}
+	try {
+		SetCacheFile(cachefile, cache);
+	} catch (std::exception& e) {
+		LslWarning("Couldn't write %s: %s", cachefile.c_str(), e.what());
+	}
+	m_metalspots_cache.Add(cachefile, spots);
+	return spots;
+}
+
+//! first line of the terrain stats cache file, change it when the format or the classes change
+static const char TERRAINSTATS_VERSION[] = "terrainstats 1";
+
+TerrainStats Unitsync::GetTerrainStats(const std::string& mapname)
+{
+	const std::string cachefile = GetFileCachePath(mapname, false) + ".terrain";
+	TerrainStats stats;
+	if (m_terrainstats_cache.TryGet(cachefile, stats)) {
+		return stats;
+	}
+
+	StringVector cache;
+	if (GetCacheFile(cachefile, cache) && cache.size() == 8 && cache[0] == TERRAINSTATS_VERSION) {
+		stats.valid = true;
+		stats.minHeight = Util::FromFloatString(cache[1]);
+		stats.maxHeight = Util::FromFloatString(cache[2]);
+		stats.meanSlope = Util::FromFloatString(cache[3]);
+		stats.maxSlope = Util::FromFloatString(cache[4]);
+		stats.waterFraction = Util::FromFloatString(cache[5]);
+		stats.flatFraction = Util::FromFloatString(cache[6]);
+		stats.passableFraction = Util::FromFloatString(cache[7]);
+		m_terrainstats_cache.Add(cachefile, stats);
+		return stats;
+	}
+
+	try {
+		float minheight = 0.0f;
+		float maxheight = 0.0f;
+		susynclib().GetMapHeightRange(mapname, minheight, maxheight);
+		const boost::shared_ptr<const RawHeightmap> heightmap = _GetRawHeightmap(mapname, false);
+		if (!heightmap->isValid() || heightmap->GetWidth() < 2)
+			return stats;
+		// the heightmap has one pixel more than squares of 8 map units per side
+		const MapSummary summary = GetMapSummary(mapname);
+		const float scale = (summary.width > 1) ? float(summary.width) / (heightmap->GetWidth() - 1) : 8.0f;
+		stats = ComputeTerrainStats(heightmap->GetData(), heightmap->GetWidth(), heightmap->GetHeight(), minheight, maxheight, scale);
+	} catch (std::exception& e) {
+		LslWarning("Couldn't get terrain stats of %s: %s", mapname.c_str(), e.what());
+		return stats;
+	}
+
+	cache.clear();
+	cache.push_back(TERRAINSTATS_VERSION);
+	cache.push_back(Util::ToFloatString(stats.minHeight));
+	cache.push_back(Util::ToFloatString(stats.maxHeight));
+	cache.push_back(Util::ToFloatString(stats.meanSlope));
+	cache.push_back(Util::ToFloatString(stats.maxSlope));
+	cache.push_back(Util::ToFloatString(stats.waterFraction));
+	cache.push_back(Util::ToFloatString(stats.flatFraction));
+	cache.push_back(Util::ToFloatString(stats.passableFraction));
+	try {
+		SetCacheFile(cachefile, cache);
+	} catch (std::exception& e) {
+		LslWarning("Couldn't write %s: %s", cachefile.c_str(), e.what());
+	}
+	m_terrainstats_cache.Add(cachefile, stats);
+	return stats;
+}
+
 UnitsyncImage Unitsync::_GetMapImage(const std::string& mapname, const std::string& imagename, UnitsyncImage (UnitsyncLib::*loadMethod)(const std::string&))
 {
 	UnitsyncImage img;
@@ -654,9 +1318,10 @@ UnitsyncImage Unitsync::_GetMapImage(const std::string& mapname, const std::stri
 		return img;
 	}
 
-	const std::string cachefile = GetFileCachePath(mapname, false, false) + imagename;
-	if (Util::FileExists(cachefile)) {
-		img = UnitsyncImage(cachefile);
+	const std::string cachefile = GetFileCachePath(mapname, false) + imagename;
+	const std::string found = FindCacheFile(cachefile);
+	if (Util::FileExists(found)) {
+		img = UnitsyncImage(found);
 	}
 
 	if (!img.isValid()) { //image seems invalid, recreate
@@ -683,88 +1348,363 @@ UnitsyncImage Unitsync::_GetScaledMapImage(const std::string& mapname, UnitsyncI
 	return img;
 }
 
-MapInfo Unitsync::_GetMapInfoEx(const std::string& mapname)
+bool Unitsync::_ReadMapInfoCache(const std::string& mapname, MapSummary& summary, MapInfo* info)
 {
-	MapInfo info;
-	info.width = 1;
-	info.height = 1;
-	if (m_mapinfo_cache.TryGet(mapname, info))
-		return info;
-	const std::string cachefile = GetFileCachePath(mapname, false, false) + ".mapinfo";
+	const std::string cachefile = GetFileCachePath(mapname, false) + ".mapinfo";
 	StringVector cache;
-	if (GetCacheFile(cachefile, cache) && cache.size() >= 11) { //cache file failed
-		info.author = cache[0];
-		info.tidalStrength = Util::FromFloatString(cache[1]);
-		info.gravity = Util::FromIntString(cache[2]);
-		info.maxMetal = Util::FromFloatString(cache[3]);
-		info.extractorRadius = Util::FromFloatString(cache[4]);
-		info.minWind = Util::FromIntString(cache[5]);
-		info.maxWind = Util::FromIntString(cache[6]);
-		info.width = Util::FromIntString(cache[7]);
-		info.height = Util::FromIntString(cache[8]);
-		const StringVector posinfo = Util::StringTokenize(cache[9], " ");
-		for (const std::string pos : posinfo) {
-			StartPos position;
-			position.x = Util::FromIntString(Util::BeforeFirst(pos, "-"));
-			position.y = Util::FromIntString(Util::AfterFirst(pos, "-"));
-			info.positions.push_back(position);
-		}
-		const unsigned int LineCount = cache.size();
-		for (unsigned int i = 10; i < LineCount; i++)
-			info.description += cache[i] + "\n";
-	} else {
-		const int index = Util::IndexInSequence(m_unsorted_map_array, mapname);
-		ASSERT_EXCEPTION(index >= 0, "Map not found");
-
-		info = susynclib().GetMapInfoEx(index, 1);
-
-		cache.push_back(info.author);
-		cache.push_back(Util::ToFloatString(info.tidalStrength));
-		cache.push_back(Util::ToIntString(info.gravity));
-		cache.push_back(Util::ToFloatString(info.maxMetal));
-		cache.push_back(Util::ToFloatString(info.extractorRadius));
-		cache.push_back(Util::ToFloatString(info.minWind));
-		cache.push_back(Util::ToFloatString(info.maxWind));
-		cache.push_back(Util::ToIntString(info.width));
-		cache.push_back(Util::ToIntString(info.height));
-
-		std::string postring;
-		for (unsigned int i = 0; i < info.positions.size(); i++) {
-			if (!postring.empty()) {
-				postring += " ";
-			}
-			postring += Util::ToIntString(info.positions[i].x) + "-" + Util::ToIntString(info.positions[i].y);
-		}
-		cache.push_back(postring);
-
-		const StringVector descrtokens = Util::StringTokenize(info.description, "\n");
-		for (const std::string descrtoken : descrtokens) {
-			cache.push_back(descrtoken);
-		}
-		SetCacheFile(cachefile, cache);
+	// the description starts at line 10
+	if (!GetCacheFile(cachefile, cache, (info != NULL) ? 0 : 11) || cache.size() < 11) { //cache file failed
+		return false;
 	}
+	summary.tidalStrength = Util::FromFloatString(cache[1]);
+	summary.gravity = Util::FromIntString(cache[2]);
+	summary.maxMetal = Util::FromFloatString(cache[3]);
+	summary.extractorRadius = Util::FromFloatString(cache[4]);
+	summary.minWind = Util::FromIntString(cache[5]);
+	summary.maxWind = Util::FromIntString(cache[6]);
+	summary.width = Util::FromIntString(cache[7]);
+	summary.height = Util::FromIntString(cache[8]);
+	const StringVector posinfo = Util::StringTokenize(cache[9], " ");
+	summary.positionCount = posinfo.size();
+	if (info == NULL)
+		return true;
 
-	m_mapinfo_cache.Add(mapname, info);
-
-	return info;
+	info->author = cache[0];
+	info->tidalStrength = summary.tidalStrength;
+	info->gravity = summary.gravity;
+	info->maxMetal = summary.maxMetal;
+	info->extractorRadius = summary.extractorRadius;
+	info->minWind = summary.minWind;
+	info->maxWind = summary.maxWind;
+	info->width = summary.width;
+	info->height = summary.height;
+	for (const std::string& pos : posinfo) {
+		StartPos position;
+		position.x = Util::FromIntString(Util::BeforeFirst(pos, "-"));
+		position.y = Util::FromIntString(Util::AfterFirst(pos, "-"));
+		info->positions.push_back(position);
+	}
+	const unsigned int LineCount = cache.size();
+	for (unsigned int i = 10; i < LineCount; i++)
+		info->description += cache[i] + "\n";
+	return true;
 }
 
-bool Unitsync::ReloadUnitSyncLib()
+bool Unitsync::_GetCachedMapSummary(const std::string& mapname, MapSummary& summary)
 {
-#if ASYNC_LOAD
-	LOCK_UNITSYNC;
-#endif
-	const std::string path = LSL::Util::config().GetCurrentUsedUnitSync();
-	if (path.empty())
+	if (m_mapsummary_cache.TryGet(mapname, summary))
+		return true;
+	if (!_ReadMapInfoCache(mapname, summary, NULL))
 		return false;
-#if ASYNC_LOAD
-	LoadUnitSyncLibAsync(path);
-#else
-	LoadUnitSyncLib(path);
-#endif
+	m_mapsummary_cache.Add(mapname, summary);
 	return true;
 }
 
+bool Unitsync::_GetCachedMapInfo(const std::string& mapname, MapInfo& info)
+{
+	if (m_mapinfo_cache.TryGet(mapname, info))
+		return true;
+	MapSummary summary;
+	if (!_ReadMapInfoCache(mapname, summary, &info))
+		return false;
+	m_mapinfo_cache.Add(mapname, info);
+	m_mapsummary_cache.Add(mapname, summary);
+	return true;
+}
+
+MapSummary Unitsync::GetMapSummary(const std::string& mapname)
+{
+	MapSummary summary;
+	if (_GetCachedMapSummary(mapname, summary))
+		return summary;
+	return MapSummary(_GetMapInfoEx(mapname));
+}
+
+MapInfo Unitsync::_GetMapInfoEx(const std::string& mapname)
+{
+	MapInfo info;
+	info.width = 1;
+	info.height = 1;
+	if (_GetCachedMapInfo(mapname, info))
+		return info;
+
+	const int index = Util::IndexInSequence(GetCatalog()->unsorted_map_array, mapname);
+	ASSERT_EXCEPTION(index >= 0, "Map not found");
+
+	info = susynclib().GetMapInfoEx(index, 1);
+	_WriteMapInfoCache(mapname, info);
+	m_mapinfo_generation++;
+	return info;
+}
+
+bool Unitsync::HasMapInfoFailed(const std::string& hash)
+{
+	boost::mutex::scoped_lock lock(m_mapinfo_failed_lock);
+	return m_mapinfo_failed.count(hash) > 0;
+}
+
+std::vector<UnitsyncMap> Unitsync::GetMapInfos(const StringVector& mapnames)
+{
+	const boost::shared_ptr<const ArchiveCatalog> catalog = GetCatalog();
+	std::vector<UnitsyncMap> ret;
+	ret.reserve(mapnames.size());
+	std::vector<bool> found;
+	found.reserve(mapnames.size());
+	std::vector<size_t> missing; // index into ret
+	std::vector<int> indices;    // unitsync index of each missing map
+	for (const std::string& mapname : mapnames) {
+		const std::string hash = FindValue(catalog->maps_list, mapname);
+		if (hash.empty())
+			continue;
+		ret.push_back(UnitsyncMap(mapname, hash));
+		ret.back().info.width = 1;
+		ret.back().info.height = 1;
+		const bool cached = _GetCachedMapInfo(mapname, ret.back().info);
+		found.push_back(cached);
+		if (cached || HasMapInfoFailed(hash))
+			continue;
+		const int index = Util::IndexInSequence(catalog->unsorted_map_array, mapname);
+		if (index < 0) {
+			continue;
+		}
+		missing.push_back(ret.size() - 1);
+		indices.push_back(index);
+	}
+
+	if (!indices.empty()) {
+		std::vector<bool> valid;
+		std::vector<MapInfo> infos;
+		try {
+			infos = susynclib().GetMapInfosEx(indices, 1, valid);
+		} catch (std::exception& e) {
+			// unitsync itself failed, not the maps, so they aren't remembered
+			LslWarning("Couldn't get map infos: %s", e.what());
+		}
+		// unitsync is unlocked again, the cache files are written afterwards
+		size_t written = 0;
+		for (size_t i = 0; i < infos.size(); i++) {
+			UnitsyncMap& map = ret[missing[i]];
+			if (!valid[i]) {
+				boost::mutex::scoped_lock lock(m_mapinfo_failed_lock);
+				m_mapinfo_failed.insert(map.hash);
+				continue;
+			}
+			map.info = infos[i];
+			found[missing[i]] = true;
+			try {
+				_WriteMapInfoCache(map.name, map.info);
+			} catch (std::exception& e) {
+				LslWarning("Couldn't write map info cache of %s: %s", map.name.c_str(), e.what());
+			}
+			written++;
+		}
+		if (written > 0)
+			m_mapinfo_generation++;
+	}
+
+	// drop the failed maps
+	size_t out = 0;
+	for (size_t i = 0; i < ret.size(); i++) {
+		if (!found[i])
+			continue;
+		if (out != i)
+			ret[out] = ret[i];
+		out++;
+	}
+	ret.resize(out);
+	return ret;
+}
+
+void Unitsync::_WriteMapInfoCache(const std::string& mapname, const MapInfo& info)
+{
+	StringVector cache;
+	cache.push_back(info.author);
+	cache.push_back(Util::ToFloatString(info.tidalStrength));
+	cache.push_back(Util::ToIntString(info.gravity));
+	cache.push_back(Util::ToFloatString(info.maxMetal));
+	cache.push_back(Util::ToFloatString(info.extractorRadius));
+	cache.push_back(Util::ToFloatString(info.minWind));
+	cache.push_back(Util::ToFloatString(info.maxWind));
+	cache.push_back(Util::ToIntString(info.width));
+	cache.push_back(Util::ToIntString(info.height));
+
+	std::string postring;
+	for (unsigned int i = 0; i < info.positions.size(); i++) {
+		if (!postring.empty()) {
+			postring += " ";
+		}
+		postring += Util::ToIntString(info.positions[i].x) + "-" + Util::ToIntString(info.positions[i].y);
+	}
+	cache.push_back(postring);
+
+	const StringVector descrtokens = Util::StringTokenize(info.description, "\n");
+	for (const std::string descrtoken : descrtokens) {
+		cache.push_back(descrtoken);
+	}
+	const std::string cachefile = GetFileCachePath(mapname, false) + ".mapinfo";
+	SetCacheFile(cachefile, cache);
+
+	m_mapinfo_cache.Add(mapname, info);
+	m_mapsummary_cache.Add(mapname, MapSummary(info));
+}
+
+boost::shared_ptr<const MapTable> Unitsync::GetMapTable(bool fetchmissing)
+{
+	{
+		boost::mutex::scoped_lock lock(m_maptable_lock);
+		// maps unitsync failed on are remembered, so a fetched table is complete until new MapInfo arrives
+		if (m_map_table && m_map_table_generation == m_mapinfo_generation && (!fetchmissing || m_map_table_fetched)) {
+			return m_map_table;
+		}
+	}
+	// unitsync is only called without the table lock, readers of the current table don't wait for it
+	const StringVector maps = GetMapList();
+	if (fetchmissing) {
+		StringVector missing;
+		MapSummary summary;
+		for (const std::string& mapname : maps) {
+			if (!_GetCachedMapSummary(mapname, summary))
+				missing.push_back(mapname);
+		}
+		if (!missing.empty())
+			GetMapInfos(missing); // all at once
+	}
+	const unsigned int generation = m_mapinfo_generation;
+	boost::shared_ptr<MapTable> table(new MapTable());
+	table->Reserve(maps.size());
+	for (const std::string& mapname : maps) {
+		MapSummary summary;
+		const bool known = _GetCachedMapSummary(mapname, summary);
+		table->Add(mapname, known ? &summary : NULL);
+	}
+	boost::mutex::scoped_lock lock(m_maptable_lock);
+	// MapInfo fetched or invalidated meanwhile may be missing, the next call builds it again
+	if (generation == m_mapinfo_generation) {
+		m_map_table_fetched = fetchmissing || (m_map_table && m_map_table_generation == generation && m_map_table_fetched);
+		m_map_table = table;
+		m_map_table_generation = generation;
+	}
+	return table;
+}
+
+bool Unitsync::ReloadUnitSyncLib()
+{
+#if ASYNC_LOAD
+	LOCK_UNITSYNC;
+#endif
+	const std::string path = LSL::Util::config().GetCurrentUsedUnitSync();
+	if (path.empty())
+		return false;
+#if ASYNC_LOAD
+	LoadUnitSyncLibAsync(path);
+#else
+	LoadUnitSyncLib(path);
+#endif
+	return true;
+}
+
+
+//! appends the names in from but not in to to removed, with a different value to changed
+static void DiffLists(const LocalArchivesVector& from, const LocalArchivesVector& to, StringVector& added, StringVector& removed, StringVector& changed)
+{
+	LocalArchivesVector::const_iterator a = from.begin();
+	LocalArchivesVector::const_iterator b = to.begin();
+	while (a != from.end() || b != to.end()) {
+		if (b == to.end() || (a != from.end() && a->first < b->first)) {
+			removed.push_back(a->first);
+			++a;
+		} else if (a == from.end() || b->first < a->first) {
+			added.push_back(b->first);
+			++b;
+		} else {
+			if (a->second != b->second)
+				changed.push_back(a->first);
+			++a;
+			++b;
+		}
+	}
+}
+
+CatalogDiff DiffCatalogs(const ArchiveCatalog& from, const ArchiveCatalog& to)
+{
+	CatalogDiff diff;
+	DiffLists(from.maps_list, to.maps_list, diff.added_maps, diff.removed_maps, diff.changed_maps);
+	DiffLists(from.mods_list, to.mods_list, diff.added_games, diff.removed_games, diff.changed_games);
+	return diff;
+}
+
+void Unitsync::InvalidateMap(const std::string& mapname)
+{
+	static const char* imagenames[] = {".minimap.png", ".metalmap.png", ".heightmap.png"};
+	m_mapsummary_cache.Remove(mapname);
+	m_mapinfo_cache.Remove(mapname);
+	m_tiny_minimap_cache.Remove(mapname);
+	m_map_gameoptions.Remove(mapname);
+	for (const char* imagename : imagenames) {
+		m_map_image_cache.Remove(mapname + imagename);
+	}
+	{
+		boost::mutex::scoped_lock lock(m_prefetch_lock);
+		m_prefetch_done.erase(mapname);
+	}
+}
+
+void Unitsync::InvalidateGame(const std::string& gamename)
+{
+	// all other game caches include the checksum in their key
+	m_game_gameoptions.Remove(gamename);
+}
+
+CatalogDiff Unitsync::RefreshArchives()
+{
+	CatalogDiff diff;
+	{
+		LOCK_UNITSYNC;
+		if (!IsLoaded())
+			return diff;
+		const boost::shared_ptr<const ArchiveCatalog> old = GetCatalog();
+		try {
+			susynclib().ReInit();
+		} catch (std::exception& e) {
+			LslWarning("Couldn't rescan archives: %s", e.what());
+			return diff;
+		}
+		const boost::shared_ptr<const ArchiveCatalog> catalog = PopulateArchiveList();
+		diff = DiffCatalogs(*old, *catalog);
+		boost::atomic_store(&m_catalog, catalog);
+		if (diff.empty())
+			return diff;
+
+		for (const std::string& mapname : diff.changed_maps) {
+			InvalidateMap(mapname);
+		}
+		for (const std::string& mapname : diff.removed_maps) {
+			InvalidateMap(mapname);
+		}
+		for (const std::string& gamename : diff.changed_games) {
+			InvalidateGame(gamename);
+		}
+		for (const std::string& gamename : diff.removed_games) {
+			InvalidateGame(gamename);
+		}
+		{
+			boost::mutex::scoped_lock lock(m_maptable_lock);
+			m_map_table.reset();
+			m_mapinfo_generation++;
+		}
+		LslDebug("Archives refreshed, maps: %d added %d removed %d changed, games: %d added %d removed %d changed",
+			 (int)diff.added_maps.size(), (int)diff.removed_maps.size(), (int)diff.changed_maps.size(),
+			 (int)diff.added_games.size(), (int)diff.removed_games.size(), (int)diff.changed_games.size());
+	}
+	// handlers may call back into Unitsync
+	const StringVector* lists[] = {&diff.added_maps, &diff.removed_maps, &diff.changed_maps, &diff.added_games, &diff.removed_games, &diff.changed_games};
+	for (const StringVector* list : lists) {
+		for (const std::string& name : *list) {
+			PostEvent(name);
+		}
+	}
+	return diff;
+}
 
 void Unitsync::SetSpringDataPath(const std::string& path)
 {
@@ -787,32 +1727,87 @@ bool Unitsync::GetSpringDataPath(std::string& path)
 	return !path.empty();
 }
 
-std::string Unitsync::GetFileCachePath(const std::string& name, bool IsMod, bool usehash)
+std::string Unitsync::GetFileCachePath(const std::string& name, bool IsMod)
 {
 	assert(!name.empty());
-	std::string ret = m_cache_path + name;
-	if (!usehash)
-		return ret;
+	const boost::shared_ptr<const ArchiveCatalog> catalog = GetCatalog();
+	// named by content: updated archives get new files, renamed or copied ones share them
+	const std::string hash = FindValue(IsMod ? catalog->mods_list : catalog->maps_list, name);
+	if (hash.empty())
+		return catalog->cache_path + name;
+	return catalog->cache_path + (IsMod ? "game-" : "map-") + hash;
+}
 
-	if (IsMod) {
-		ret += "-" + m_mods_list[name];
-	} else {
-		ret += "-" + m_maps_list[name];
-	}
-	return ret;
+std::string Unitsync::GetMapImageCachePath(const std::string& mapname, const std::string& imagename)
+{
+	return FindCacheFile(GetFileCachePath(mapname, false) + imagename);
+}
+
+std::string Unitsync::GetSidePictureCachePath(const std::string& gamename, const std::string& sidename)
+{
+	return FindCacheFile(GetFileCachePath(gamename, true) + "-side-" + sidename + ".png");
+}
+
+std::string Unitsync::GetSideAtlasCachePath(const std::string& gamename)
+{
+	return FindCacheFile(GetFileCachePath(gamename, true) + ".sideatlas.png");
+}
+
+void Unitsync::SetSharedCachePath(const std::string& path)
+{
+	boost::mutex::scoped_lock lock(m_shared_cache_lock);
+	m_shared_cache_path = path.empty() ? path : Util::EnsureDelimiter(path);
+}
+
+std::string Unitsync::GetSharedCachePath() const
+{
+	boost::mutex::scoped_lock lock(m_shared_cache_lock);
+	return m_shared_cache_path;
+}
+
+std::string Unitsync::GetSharedCacheFile(const std::string& path) const
+{
+	const std::string shared = GetSharedCachePath();
+	const std::string& own = GetCatalog()->cache_path;
+	if (shared.empty() || own.empty() || path.compare(0, own.size(), own) != 0)
+		return std::string();
+	return shared + path.substr(own.size());
 }
 
-bool Unitsync::GetCacheFile(const std::string& path, StringVector& ret) const
+std::string Unitsync::FindCacheFile(const std::string& path) const
+{
+	if (Util::FileExists(path))
+		return path;
+	const std::string shared = GetSharedCacheFile(path);
+	if (!shared.empty() && Util::FileExists(shared))
+		return shared;
+	return path;
+}
+
+bool Unitsync::GetCacheFile(const std::string& path, StringVector& ret, size_t maxlines) const
 {
 	FILE* file = Util::lslopen(path, "r");
-	if (file == NULL)
-		return false;
+	if (file == NULL) {
+		const std::string shared = GetSharedCacheFile(path);
+		if (shared.empty())
+			return false;
+		file = Util::lslopen(shared, "r");
+		if (file == NULL)
+			return false;
+	}
 	ret.clear();
-	char line[1024];
-	while (fgets(line, 1024, file) != NULL) {
-		const int len = strnlen(line, 1024);
-		ret.push_back(std::string(line, len - 1));
+	char buf[1024];
+	std::string line;
+	while ((maxlines == 0 || ret.size() < maxlines) && fgets(buf, sizeof(buf), file) != NULL) {
+		line += buf;
+		if (line[line.size() - 1] == '\n') {
+			line.resize(line.size() - 1);
+			ret.push_back(line);
+			line.clear();
+		}
 	}
+	if (!line.empty())
+		ret.push_back(line);
 	fclose(file);
 	return true;
 }
@@ -845,15 +1840,7 @@ StringVector Unitsync::GetPlaybackList(bool ReplayType) const
 		type = ".ssf";
 		subpath = "Saves";
 	}
-	const int count = susynclib().GetSpringDataDirCount();
-	StringVector paths;
-	for (int i = 0; i < count; i++) {
-		const std::string datadir = susynclib().GetSpringDataDirByIndex(i);
-		if (datadir.empty()) {
-			continue;
-		}
-		paths.push_back(datadir);
-	}
+	const StringVector paths = GetDataDirs();
 	try {
 		for (const std::string datadir : paths) {
 			const std::string dir = Util::EnsureDelimiter(datadir) + subpath;
@@ -878,6 +1865,39 @@ StringVector Unitsync::GetPlaybackList(bool ReplayType) const
 	return ret;
 }
 
+StringVector Unitsync::GetDataDirs() const
+{
+	StringVector ret;
+	const int count = susynclib().GetSpringDataDirCount();
+	for (int i = 0; i < count; i++) {
+		const std::string datadir = susynclib().GetSpringDataDirByIndex(i);
+		if (datadir.empty()) {
+			continue;
+		}
+		ret.push_back(datadir);
+	}
+	return ret;
+}
+
+std::vector<ReplayInfo> Unitsync::GetReplayInfos(bool scripts)
+{
+	StringVector dirs;
+	{
+		TRY_LOCK(std::vector<ReplayInfo>())
+		if (!IsLoaded())
+			return std::vector<ReplayInfo>();
+		for (const std::string& datadir : GetDataDirs()) {
+			dirs.push_back(Util::EnsureDelimiter(datadir) + "demos");
+		}
+		m_replay_index.SetCacheFile(GetCatalog()->cache_path + "replays.idx");
+	}
+	StringVector extensions;
+	extensions.push_back(".sdf");
+	extensions.push_back(".sdfz");
+	m_replay_index.Refresh(dirs, extensions);
+	return m_replay_index.GetReplays(scripts);
+}
+
 bool Unitsync::FileExists(const std::string& name) const
 {
 	assert(!name.empty());
@@ -897,6 +1917,76 @@ std::string Unitsync::GetArchivePath(const std::string& name) const
 	return susynclib().GetArchivePath(name);
 }
 
+std::string Unitsync::GetMapArchive(const std::string& mapname) const
+{
+	return FindValue(GetCatalog()->maps_archive_name, mapname);
+}
+
+std::string Unitsync::GetGameArchive(const std::string& gamename) const
+{
+	return FindValue(GetCatalog()->mods_archive_name, gamename);
+}
+
+//! first line of the archive index cache file, change it when the format changes
+static const char ARCHIVEINDEX_VERSION[] = "archiveindex 1";
+
+boost::shared_ptr<const ArchiveIndex> Unitsync::GetArchiveIndex(const std::string& name, bool IsGame)
+{
+	assert(!name.empty());
+	// one "size\tname" line per file after the version
+	const std::string cachefile = GetFileCachePath(name, IsGame) + ".files";
+	boost::shared_ptr<const ArchiveIndex> cached;
+	if (m_archiveindex_cache.TryGet(cachefile, cached)) {
+		return cached;
+	}
+
+	std::vector<std::pair<std::string, int>> files;
+	StringVector cache;
+	if (GetCacheFile(cachefile, cache) && !cache.empty() && cache[0] == ARCHIVEINDEX_VERSION) {
+		files.reserve(cache.size() - 1);
+		for (size_t i = 1; i < cache.size(); i++) {
+			const size_t tab = cache[i].find('\t');
+			if (tab == std::string::npos)
+				continue;
+			files.push_back(std::make_pair(cache[i].substr(tab + 1), Util::FromIntString(cache[i].substr(0, tab))));
+		}
+		boost::shared_ptr<const ArchiveIndex> index(new ArchiveIndex(files));
+		m_archiveindex_cache.Add(cachefile, index);
+		return index;
+	}
+
+	const std::string archive = IsGame ? GetGameArchive(name) : GetMapArchive(name);
+	if (archive.empty()) {
+		LslWarning("No archive known for %s", name.c_str());
+		return boost::shared_ptr<const ArchiveIndex>(new ArchiveIndex());
+	}
+	try {
+		susynclib().GetArchiveFiles(GetArchivePath(archive) + archive, files);
+	} catch (std::exception& e) {
+		LslWarning("Couldn't list the files of %s: %s", archive.c_str(), e.what());
+		return boost::shared_ptr<const ArchiveIndex>(new ArchiveIndex());
+	}
+	cache.clear();
+	cache.reserve(files.size() + 1);
+	cache.push_back(ARCHIVEINDEX_VERSION);
+	for (const auto& file : files) {
+		cache.push_back(Util::ToIntString(file.second) + "\t" + file.first);
+	}
+	try {
+		SetCacheFile(cachefile, cache);
+	} catch (std::exception& e) {
+		LslWarning("Couldn't write %s: %s", cachefile.c_str(), e.what());
+	}
+	boost::shared_ptr<const ArchiveIndex> index(new ArchiveIndex(files));
+	m_archiveindex_cache.Add(cachefile, index);
+	return index;
+}
+
+StringVector Unitsync::FindArchiveFiles(const std::string& name, bool IsGame, const std::string& pattern)
+{
+	return GetArchiveIndex(name, IsGame)->FindGlob(pattern);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////// Unitsync prefetch/background thread code
 
@@ -942,14 +2032,42 @@ public:
 		PostEvent();
 	}
 
+	void Discarded()
+	{
+		m_mapname = std::string(); // counts as failed job
+		PostEvent();
+	}
+
+	const std::string& GetMapName() const
+	{
+		return m_mapname;
+	}
+	bool IsImage() const
+	{
+		return m_evtId != ASYNC_MAP_EX_EVT;
+	}
+	//! priority when the map isn't visible
+	int GetBasePriority() const
+	{
+		return IsImage() ? 100 : 200 /* higher prio then GetMinimapAsync */;
+	}
+
 protected:
 	std::string m_mapname;
 	Unitsync* m_usync;
+	const int m_evtId;
 
 	GetMapImageAsyncResult(Unitsync* usync, const std::string& mapname, int evtId)
 	    : m_mapname(mapname.c_str())
 	    , m_usync(usync)
+	    , m_evtId(evtId)
 	{
+		m_usync->BeginUserRequest();
+	}
+
+	~GetMapImageAsyncResult()
+	{
+		m_usync->EndUserRequest();
 	}
 
 private:
@@ -1012,6 +2130,36 @@ public:
 	{
 	}
 };
+
+class PrefetchBattleMapWorkItem : public WorkItem
+{
+public:
+	void Run()
+	{
+		if (m_usync->HasUserRequests()) // back off, the map is scheduled again when they are done
+			return;
+		m_fetched = true; // don't retry maps which fail
+		m_usync->GetMap(m_mapname);
+		m_usync->GetMinimap(m_mapname, 100, 100);
+	}
+
+	PrefetchBattleMapWorkItem(Unitsync* usync, const std::string& mapname)
+	    : m_usync(usync)
+	    , m_mapname(mapname.c_str())
+	    , m_fetched(false)
+	{
+	}
+
+	~PrefetchBattleMapWorkItem()
+	{
+		m_usync->PrefetchBattleMapDone(m_mapname, m_fetched);
+	}
+
+private:
+	Unitsync* m_usync;
+	std::string m_mapname;
+	bool m_fetched;
+};
 }
 
 
@@ -1043,6 +2191,54 @@ public:
 	}
 };
 
+class AnalyzeMapWorkItem : public WorkItem
+{
+public:
+	AnalyzeMapWorkItem(Unitsync* usync, const boost::shared_ptr<const ArchiveCatalog>& catalog, size_t index)
+	    : m_usync(usync)
+	    , m_catalog(catalog)
+	    , m_index(index)
+	{
+	}
+	void Run()
+	{
+		if (m_usync->GetCatalog() != m_catalog) // reloaded, the indices are stale
+			return;
+		try {
+			m_usync->GetMetalSpots(m_catalog->unsorted_map_array[m_index]);
+			m_usync->GetTerrainStats(m_catalog->unsorted_map_array[m_index]);
+		} catch (std::exception& e) {
+			LslWarning("Analyzing %s failed: %s", m_catalog->unsorted_map_array[m_index].c_str(), e.what());
+		}
+		m_usync->AnalyzeMapDone(m_catalog, m_index);
+	}
+
+private:
+	Unitsync* m_usync;
+	boost::shared_ptr<const ArchiveCatalog> m_catalog;
+	size_t m_index;
+};
+
+class RefreshArchivesWorkItem : public WorkItem
+{
+public:
+	RefreshArchivesWorkItem(Unitsync* usync)
+	    : m_usync(usync)
+	{
+	}
+	void Run()
+	{
+		try {
+			m_usync->RefreshArchives();
+		} catch (std::exception& e) {
+			LslWarning("Refreshing archives failed: %s", e.what());
+		}
+	}
+
+private:
+	Unitsync* m_usync;
+};
+
 
 void Unitsync::PrefetchMap(const std::string& mapname)
 {
@@ -1074,6 +2270,129 @@ void Unitsync::PrefetchMap(const std::string& mapname)
 	}
 }
 
+// runs after every other WorkItem but the map analysis sweep
+static const int PREFETCH_BATTLE_MAP_PRIORITY = std::numeric_limits<int>::min() + 1;
+// only one map of the sweep is queued at a time, so it never delays other work for long
+static const int ANALYZE_MAP_PRIORITY = std::numeric_limits<int>::min();
+// half life in seconds of the weight of a battle map hint
+static const double PREFETCH_HALF_LIFE = 300.0;
+static const size_t MAX_PREFETCH_CANDIDATES = 1000;
+
+double Unitsync::PrefetchTime() const
+{
+	return (boost::posix_time::microsec_clock::universal_time() - m_prefetch_epoch).total_milliseconds() / 1000.0;
+}
+
+void Unitsync::PrefetchBattleMap(const std::string& mapname, int users)
+{
+	// most battles of a public server use maps which aren't installed
+	if (mapname.empty() || !MapExists(mapname))
+		return;
+	{
+		boost::mutex::scoped_lock lock(m_prefetch_lock);
+		PrefetchCandidate& candidate = m_prefetch_candidates[mapname];
+		candidate.users = std::max(0, users);
+		candidate.lastseen = PrefetchTime();
+		if (m_prefetch_candidates.size() > MAX_PREFETCH_CANDIDATES) { // forget the oldest hint
+			auto oldest = m_prefetch_candidates.begin();
+			for (auto it = m_prefetch_candidates.begin(); it != m_prefetch_candidates.end(); ++it) {
+				if (it->second.lastseen < oldest->second.lastseen)
+					oldest = it;
+			}
+			m_prefetch_done.erase(oldest->first);
+			m_prefetch_candidates.erase(oldest);
+		}
+	}
+	SchedulePrefetch();
+}
+
+void Unitsync::SetPrefetchBudget(size_t maxqueued, size_t maxmemory)
+{
+	{
+		boost::mutex::scoped_lock lock(m_prefetch_lock);
+		m_prefetch_maxqueued = maxqueued;
+		m_prefetch_maxmemory = maxmemory;
+	}
+	SchedulePrefetch();
+}
+
+void Unitsync::SchedulePrefetch()
+{
+	if (!m_cache_thread || HasUserRequests())
+		return;
+	// prefetching would only evict what the user fetched
+	const size_t budget = m_memory_governor.GetBudget();
+	if (budget > 0 && m_memory_governor.GetUsage() > budget / 4 * 3)
+		return;
+	boost::mutex::scoped_lock lock(m_prefetch_lock);
+	const double now = PrefetchTime();
+	// what's resident, prefetched entries evicted by the governor free their share again
+	while (m_prefetch_queued.size() < m_prefetch_maxqueued && PrefetchMemoryUsage() < m_prefetch_maxmemory) {
+		// weight is the number of users, halved every PREFETCH_HALF_LIFE seconds since the last hint
+		std::string best;
+		double bestweight = 0.0;
+		for (const auto& it : m_prefetch_candidates) {
+			if (m_prefetch_done.count(it.first) > 0 || m_prefetch_queued.count(it.first) > 0)
+				continue;
+			const double weight = (1 + it.second.users) * std::pow(0.5, (now - it.second.lastseen) / PREFETCH_HALF_LIFE);
+			if (weight > bestweight) {
+				best = it.first;
+				bestweight = weight;
+			}
+		}
+		if (best.empty())
+			break;
+		m_prefetch_queued.insert(best);
+		m_cache_thread->DoWork(new PrefetchBattleMapWorkItem(this, best), PREFETCH_BATTLE_MAP_PRIORITY);
+	}
+}
+
+size_t Unitsync::PrefetchMemoryUsage() const
+{
+	return m_mapinfo_cache.GetMemoryUsage() + m_tiny_minimap_cache.GetMemoryUsage();
+}
+
+void Unitsync::PrefetchBattleMapDone(const std::string& mapname, bool fetched)
+{
+	{
+		boost::mutex::scoped_lock lock(m_prefetch_lock);
+		m_prefetch_queued.erase(mapname);
+		// only maps which are still candidates, so m_prefetch_done stays bounded by them
+		if (fetched && m_prefetch_candidates.count(mapname) > 0)
+			m_prefetch_done.insert(mapname);
+	}
+	SchedulePrefetch();
+}
+
+void Unitsync::AnalyzeMapsAsync()
+{
+	const boost::shared_ptr<const ArchiveCatalog> catalog = GetCatalog();
+	if (!m_cache_thread || catalog->unsorted_map_array.empty())
+		return;
+	m_cache_thread->DoWork(new AnalyzeMapWorkItem(this, catalog, 0), ANALYZE_MAP_PRIORITY);
+}
+
+void Unitsync::AnalyzeMapDone(const boost::shared_ptr<const ArchiveCatalog>& catalog, size_t index)
+{
+	if (index + 1 >= catalog->unsorted_map_array.size()) {
+		LslDebug("Analyzed %d maps", (int)catalog->unsorted_map_array.size());
+		return;
+	}
+	if (m_cache_thread)
+		m_cache_thread->DoWork(new AnalyzeMapWorkItem(this, catalog, index + 1), ANALYZE_MAP_PRIORITY);
+}
+
+void Unitsync::BeginUserRequest()
+{
+	m_user_requests++;
+}
+
+void Unitsync::EndUserRequest()
+{
+	if (--m_user_requests == 0)
+		SchedulePrefetch();
+}
+
 boost::signals2::connection Unitsync::RegisterEvtHandler(const StringSignalSlotType& handler)
 {
 	return m_async_ops_complete_sig.connect(handler);
@@ -1099,7 +2418,7 @@ void Unitsync::_GetMapImageAsync(const std::string& mapname, UnitsyncImage (Unit
 	}
 	GetMapImageAsyncWorkItem* work;
 	work = new GetMapImageAsyncWorkItem(this, mapname, loadMethod);
-	m_cache_thread->DoWork(work, 100);
+	m_cache_thread->DoWork(work, GetAsyncPriority(mapname, work->GetBasePriority()));
 }
 
 void Unitsync::GetMinimapAsync(const std::string& mapname)
@@ -1118,7 +2437,7 @@ void Unitsync::GetMinimapAsync(const std::string& mapname, int width, int height
 	}
 	GetScaledMapImageAsyncWorkItem* work;
 	work = new GetScaledMapImageAsyncWorkItem(this, mapname, width, height, &Unitsync::GetMinimap);
-	m_cache_thread->DoWork(work, 100);
+	m_cache_thread->DoWork(work, GetAsyncPriority(mapname, work->GetBasePriority()));
 }
 
 void Unitsync::GetMetalmapAsync(const std::string& mapname)
@@ -1157,7 +2476,56 @@ void Unitsync::GetMapExAsync(const std::string& mapname)
 	}
 	GetMapExAsyncWorkItem* work;
 	work = new GetMapExAsyncWorkItem(this, mapname);
-	m_cache_thread->DoWork(work, 200 /* higher prio then GetMinimapAsync */);
+	m_cache_thread->DoWork(work, GetAsyncPriority(mapname, work->GetBasePriority()));
+}
+
+size_t Unitsync::GetCacheMemoryUsage() const
+{
+	return m_memory_governor.GetUsage();
+}
+
+std::map<std::string, size_t> Unitsync::GetCacheMemoryUsageByCache() const
+{
+	return m_memory_governor.GetUsageByCache();
+}
+
+void Unitsync::SetCacheMemoryBudget(size_t bytes)
+{
+	m_memory_governor.SetBudget(bytes);
+}
+
+// visible maps are above all hidden requests, but below loading unitsync (500)
+static const int VISIBLE_PRIORITY_BOOST = 200;
+
+int Unitsync::GetAsyncPriority(const std::string& mapname, int priority)
+{
+	boost::mutex::scoped_lock lock(m_visible_lock);
+	if (m_visible_maps.count(mapname) > 0)
+		return priority + VISIBLE_PRIORITY_BOOST;
+	return priority;
+}
+
+void Unitsync::SetVisibleMaps(const StringSet& mapnames)
+{
+	{
+		boost::mutex::scoped_lock lock(m_visible_lock);
+		m_visible_maps = mapnames;
+	}
+	if (!m_cache_thread)
+		return;
+	m_cache_thread->Reprioritize([&mapnames](WorkItem* item, int& priority) {
+		const GetMapImageAsyncResult* request = dynamic_cast<GetMapImageAsyncResult*>(item);
+		if (request == NULL) // prefetching etc.
+			return true;
+		if (mapnames.empty() || mapnames.count(request->GetMapName()) == 0) {
+			if (!mapnames.empty() && request->IsImage())
+				return false; // row isn't visible anymore, the client asks again when it is
+			priority = request->GetBasePriority();
+			return true;
+		}
+		priority = request->GetBasePriority() + VISIBLE_PRIORITY_BOOST;
+		return true;
+	});
 }
 
 std::string Unitsync::GetTextfileAsString(const std::string& gamename, const std::string& file_path)
@@ -1191,6 +2559,51 @@ void Unitsync::LoadUnitSyncLibAsync(const std::string& filename)
 	m_cache_thread->DoWork(work, 500);
 }
 
+//! true if file is an archive or one of the watched dirs (events were lost)
+static bool IsArchiveChange(const std::string& file)
+{
+	static const char* extensions[] = {".sd7", ".sdz", ".sdp", ".sdd"};
+	const std::string lower = boost::to_lower_copy(file);
+	for (const char* ext : extensions) {
+		if (boost::ends_with(lower, ext))
+			return true;
+	}
+	return boost::filesystem::is_directory(file);
+}
+
+bool Unitsync::StartDataDirWatcher(int debouncems)
+{
+	StopDataDirWatcher();
+	if (!IsLoaded() || !Util::DirWatcher::IsSupported())
+		return false;
+	StringVector dirs;
+	for (const std::string& datadir : GetDataDirs()) {
+		dirs.push_back(Util::EnsureDelimiter(datadir) + "maps");
+		dirs.push_back(Util::EnsureDelimiter(datadir) + "games");
+		dirs.push_back(Util::EnsureDelimiter(datadir) + "packages");
+	}
+	m_datadir_watcher = new Util::DirWatcher();
+	const bool started = m_datadir_watcher->Start(dirs, [this](const StringVector& changed) {
+		for (const std::string& file : changed) {
+			if (IsArchiveChange(file)) {
+				LslDebug("Archive changed: %s", file.c_str());
+				m_cache_thread->DoWork(new RefreshArchivesWorkItem(this), 500);
+				return;
+			}
+		}
+	}, debouncems);
+	if (!started) {
+		StopDataDirWatcher();
+	}
+	return started;
+}
+
+void Unitsync::StopDataDirWatcher()
+{
+	delete m_datadir_watcher;
+	m_datadir_watcher = NULL;
+}
+
 int Unitsync::GetSpringConfigInt(const std::string& name, int defvalue)
 {
 	if (IsLoaded())
@@ -8,10 +8,16 @@
 #include "mru_cache.h"
 #include <lslutils/type_forwards.h>
 #include "image.h"
+#include "replayindex.h"
+#include "mapanalysis.h"
+#include "mappreview.h"
 
 #include <boost/thread/mutex.hpp>
 #include <boost/signals2/signal.hpp>
 #include <map>
+#include <set>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <atomic>
 
 #ifdef HAVE_WX
 #include <wx/event.h>
@@ -20,11 +26,106 @@ namespace LSL
 {
 
 class UnitsyncImage;
-struct GameOptions;
 struct CachedMapInfo;
 struct SpringMapInfo;
 class UnitsyncLib;
 class WorkerThread;
+class MapTable;
+class UnitIndex;
+class RawHeightmap;
+class ArchiveIndex;
+namespace Util
+{
+class DirWatcher;
+}
+
+struct GameOptions
+{
+	OptionMapBool bool_map;
+	OptionMapFloat float_map;
+	OptionMapString string_map;
+	OptionMapList list_map;
+	OptionMapSection section_map;
+
+	//! heap memory of all options, for the caches
+	size_t GetMemoryUsage() const;
+};
+
+//! all side pictures of a game packed into one image
+struct SideAtlas
+{
+	struct Rect
+	{
+		int x;
+		int y;
+		int width;
+		int height;
+	};
+	UnitsyncImage image;
+	std::map<std::string, Rect> sides; //! position in image by lower case side name
+	std::set<std::string> missing;	   //! lower case sides of GetSides() without a picture, not written to disk
+
+	//! the picture of the side cut from the atlas, invalid if there is none
+	UnitsyncImage GetSidePicture(const std::string& sidename) const;
+	size_t GetMemoryUsage() const;
+};
+
+//! skirmish AIs usable with a game
+struct AICatalog
+{
+	StringVector names;		 //! "shortName version" per AI, as returned by GetAIList()
+	std::vector<StringVector> infos; //! key, value, description triples per AI, as returned by GetAIInfos()
+
+	size_t GetMemoryUsage() const;
+};
+
+typedef MostRecentlyUsedCache<MapSummary, FixedMemoryCost<MapSummary>> MostRecentlyUsedMapSummaryCache;
+typedef MostRecentlyUsedCache<GameOptions> MostRecentlyUsedGameOptionsCache;
+typedef MostRecentlyUsedCache<boost::shared_ptr<const UnitIndex>> MostRecentlyUsedUnitIndexCache;
+typedef MostRecentlyUsedCache<boost::shared_ptr<const SideAtlas>> MostRecentlyUsedSideAtlasCache;
+typedef MostRecentlyUsedCache<boost::shared_ptr<const AICatalog>> MostRecentlyUsedAICatalogCache;
+typedef MostRecentlyUsedCache<boost::shared_ptr<const RawHeightmap>> MostRecentlyUsedRawHeightmapCache;
+typedef MostRecentlyUsedCache<std::vector<MetalSpot>, FixedVectorMemoryCost<MetalSpot>> MostRecentlyUsedMetalSpotsCache;
+typedef MostRecentlyUsedCache<TerrainStats, FixedMemoryCost<TerrainStats>> MostRecentlyUsedTerrainStatsCache;
+typedef MostRecentlyUsedCache<boost::shared_ptr<const ArchiveIndex>> MostRecentlyUsedArchiveIndexCache;
+
+/** maps and games found by unitsync and the settings they were loaded with.
+ * A reload builds a new catalog and publishes it as a whole, a published
+ * catalog is never changed, so it can be read from any thread without locking. */
+struct ArchiveCatalog
+{
+	LocalArchivesVector maps_list;		/// mapname -> hash
+	LocalArchivesVector mods_list;		/// gamename -> hash
+	LocalArchivesVector mods_archive_name;  /// gamename -> archive name
+	LocalArchivesVector maps_archive_name;  /// mapname -> archive name
+	StringVector map_array;			// this vector is CUSTOM SORTED ALPHABETICALLY, DON'T USE TO ACCESS UNITSYNC DIRECTLY
+	StringVector mod_array;			// this vector is CUSTOM SORTED ALPHABETICALLY, DON'T USE TO ACCESS UNITSYNC DIRECTLY
+	StringVector unsorted_map_array;	// this is because unitsync doesn't have a search map index by name ..
+	StringVector unsorted_mod_array;	// this isn't necessary but makes things more symmetrical :P
+	/// sett().GetCachePath() at load time, because that method calls back into
+	/// susynclib(), there's a good chance main thread blocks on some
+	/// WorkerThread operation...
+	std::string cache_path;
+	//! engine version of the loaded unitsync, part of the cache keys of engine dependent data
+	std::string engine_version;
+};
+
+//! names of the maps and games which differ between two catalogs
+struct CatalogDiff
+{
+	StringVector added_maps;
+	StringVector removed_maps;
+	StringVector changed_maps; //! same name, different checksum
+	StringVector added_games;
+	StringVector removed_games;
+	StringVector changed_games;
+	bool empty() const
+	{
+		return added_maps.empty() && removed_maps.empty() && changed_maps.empty() && added_games.empty() && removed_games.empty() && changed_games.empty();
+	}
+};
+
+CatalogDiff DiffCatalogs(const ArchiveCatalog& from, const ArchiveCatalog& to);
 
 #ifdef HAVE_WX
 extern const wxEventType UnitSyncAsyncOperationCompletedEvt;
@@ -43,6 +144,9 @@ public:
 	Unitsync();
 	~Unitsync();
 
+	//! the current catalog, stays valid and unchanged while a reload publishes a new one
+	boost::shared_ptr<const ArchiveCatalog> GetCatalog() const;
+
 	StringVector GetGameList() const;
 	bool GameExists(const std::string& gamename, const std::string& hash = "") const;
 	UnitsyncGame GetGame(const std::string& gamename);
@@ -52,15 +156,35 @@ public:
 	StringVector GetGameDeps(const std::string& name) const;
 
 	StringVector GetMapList() const;
-	StringVector GetGameValidMapList(const std::string& gamename) const;
+	//! cached per game checksum in memory and on disk
+	StringVector GetGameValidMapList(const std::string& gamename);
 	bool MapExists(const std::string& mapname, const std::string& hash = "") const;
+	//! returns the checksum of the map without fetching its MapInfo, empty when not found
+	std::string GetMapHash(const std::string& mapname) const;
+	/** MapInfo of the map without description, author and start positions.
+	 * Copying it allocates nothing, use it for map lists. */
+	MapSummary GetMapSummary(const std::string& mapname);
 
 	UnitsyncMap GetMap(const std::string& mapname);
 	UnitsyncMap GetMap(int index);
+	/** GetMap() for many maps: cached ones are resolved first, all others are
+	 * fetched while unitsync is locked once. Unknown maps and maps unitsync
+	 * fails on are left out, the others keep the order of mapnames. Failed
+	 * maps aren't fetched again until the archive changes or the cache is cleared. */
+	std::vector<UnitsyncMap> GetMapInfos(const StringVector& mapnames);
 	GameOptions GetMapOptions(const std::string& name);
+	/** snapshot of the numeric MapInfo fields of all maps for fast filtering,
+	 * rows are in GetMapList() order. Only cached MapInfo is used unless
+	 * fetchmissing is set, the table is rebuilt when new MapInfo was fetched
+	 * or unitsync was reloaded. */
+	boost::shared_ptr<const MapTable> GetMapTable(bool fetchmissing = false);
 
 	StringVector GetSides(const std::string& gamename);
+	//! picture of the side, taken from GetSideAtlas()
 	UnitsyncImage GetSidePicture(const std::string& gamename, const std::string& SideName);
+	/** all side pictures of the game, extracted in one pass the first time the
+	 * game is seen and cached per game checksum as one image plus offset table */
+	boost::shared_ptr<const SideAtlas> GetSideAtlas(const std::string& gamename);
 
 	bool LoadUnitSyncLib(const std::string& unitsyncloc);
 	void FreeUnitSyncLib();
@@ -70,12 +194,20 @@ public:
 	std::string GetSpringVersion() const;
 	void UnSetCurrentArchive();
 
-	StringVector GetAIList(const std::string& gamename) const;
-	StringVector GetAIInfos(int index) const;
+	//! cached per game checksum and engine version in memory and on disk
+	StringVector GetAIList(const std::string& gamename);
+	//! infos of an AI of the game last passed to GetAIList()
+	StringVector GetAIInfos(int index);
+	StringVector GetAIInfos(const std::string& gamename, int index);
+	//! GetAIList() and GetAIInfos() of all AIs of the game at once
+	boost::shared_ptr<const AICatalog> GetAICatalog(const std::string& gamename);
 	GameOptions GetAIOptions(const std::string& gamename, int index);
 
 
+	//! "Full Name (unitname)" for all units of the game, built from GetUnitIndex()
 	StringVector GetUnitsList(const std::string& gamename);
+	//! searchable unit table of the game, shared and cached per game checksum
+	boost::shared_ptr<const UnitIndex> GetUnitIndex(const std::string& gamename);
 
 	/// get minimap rescaled to given width x height
 	UnitsyncImage GetMinimap(const std::string& mapname, int width, int height);
@@ -83,22 +215,99 @@ public:
 	UnitsyncImage GetMetalmap(const std::string& mapname, int width, int height);
 	/// get heightmap rescaled to given width x height
 	UnitsyncImage GetHeightmap(const std::string& mapname, int width, int height);
+	/** unscaled 16 bit heights of the map, fetched from unitsync only once
+	 * per map checksum and kept in the cache dir. Invalid if the map has no
+	 * heightmap or unitsync failed. */
+	boost::shared_ptr<const RawHeightmap> GetRawHeightmap(const std::string& mapname);
+	/** clusters of the metal infomap of the map, cached per map checksum.
+	 * Empty for maps without metal, for metal maps with metal everywhere
+	 * or if unitsync failed. See MetalSpotThreshold(). */
+	std::vector<MetalSpot> GetMetalSpots(const std::string& mapname);
+	/** slope and terrain class statistics of the map, cached per map checksum.
+	 * Invalid if unitsync failed or doesn't report the height range. */
+	TerrainStats GetTerrainStats(const std::string& mapname);
+	/** minimap with the given MapPreviewLayer's blended in, fit into width x height
+	 * with the aspect ratio of the map. Cached per map checksum, size and layers,
+	 * unless unitsync failed on one of the layers, which is left out then. */
+	UnitsyncImage GetMapPreview(const std::string& mapname, int width, int height, int layers = PREVIEW_ALL);
 
 	bool ReloadUnitSyncLib();
+	/** rescans the data dirs without reloading unitsync and publishes the new
+	 * catalog. Unlike ReloadUnitSyncLib() only the cached data of maps and
+	 * games which were added, removed or changed is dropped. An event with
+	 * the name of each of them is posted. */
+	CatalogDiff RefreshArchives();
+	/** watches the maps, games and packages dirs of all data dirs and runs
+	 * RefreshArchives() in background after archives were added, replaced or
+	 * removed and no further change happened for debouncems.
+	 * Only supported on linux, false if nothing could be watched. */
+	bool StartDataDirWatcher(int debouncems = 2000);
+	void StopDataDirWatcher();
 
 	void SetSpringDataPath(const std::string& path);
 	bool GetSpringDataPath(std::string& path);
 
 	StringVector GetPlaybackList(bool ReplayType = true) const; //savegames otehrwise
+	/** metadata of all replays in the demos dirs, refreshed incrementally on each
+	 * call: only new or changed files are read, in parallel and without holding the unitsync lock */
+	std::vector<ReplayInfo> GetReplayInfos(bool scripts = false);
 
 	std::string GetArchivePath(const std::string& name) const;
+	//! file name of the archive containing the map, empty if unknown
+	std::string GetMapArchive(const std::string& mapname) const;
+	//! file name of the archive containing the game, empty if unknown
+	std::string GetGameArchive(const std::string& gamename) const;
+	/** names and sizes of the files in the primary archive of a map or game,
+	 * read from unitsync once per checksum and kept in the cache dir.
+	 * Empty if the archive couldn't be read. */
+	boost::shared_ptr<const ArchiveIndex> GetArchiveIndex(const std::string& name, bool IsGame);
+	//! files of GetArchiveIndex() matching the glob pattern, case insensitive
+	StringVector FindArchiveFiles(const std::string& name, bool IsGame, const std::string& pattern);
+
+	/** path of the cached image, imagename is one of ".minimap.png",
+	 * ".metalmap.png" or ".heightmap.png". The file exists only after the
+	 * image was fetched once. Points into the shared cache if only that has it. */
+	std::string GetMapImageCachePath(const std::string& mapname, const std::string& imagename);
+	//! path of the cached side picture, exists only if the side is missing in the atlas
+	std::string GetSidePictureCachePath(const std::string& gamename, const std::string& sidename);
+	//! path of the side atlas image, exists only after GetSideAtlas() was called and the game has side pictures
+	std::string GetSideAtlasCachePath(const std::string& gamename);
+
+	/** read-only cache dir filled by another host or baked into an image.
+	 * Cache files are named by archive checksum, so files missing in the own
+	 * cache dir are taken from there. It's never written to, empty disables it. */
+	void SetSharedCachePath(const std::string& path);
+	std::string GetSharedCachePath() const;
 
 	/// schedule a map for prefetching
 	void PrefetchMap(const std::string& mapname);
+	/** battle list hint: mapname is used by a battle with the given number of users,
+	 * ignored if the map isn't installed.
+	 * MapInfo and a tiny minimap of the maps with the highest weight (users and
+	 * recency of the hint) are fetched in background while no user requests are pending. */
+	void PrefetchBattleMap(const std::string& mapname, int users);
+	/** budget of the battle map prefetcher: max number of prefetch items queued at once
+	 * and max memory of the MapInfo and tiny minimap caches in bytes up to which
+	 * the prefetcher fills them, 0 disables it */
+	void SetPrefetchBudget(size_t maxqueued, size_t maxmemory);
+	/** analyzes all maps of the current catalog one by one in background,
+	 * so GetMetalSpots() is answered from the cache afterwards. Other work
+	 * items always run first, the sweep stops when the catalog changes.
+	 * Also fills the GetTerrainStats() cache. */
+	void AnalyzeMapsAsync();
 
 	boost::signals2::connection RegisterEvtHandler(const StringSignalSlotType& handler);
 	void UnregisterEvtHandler(boost::signals2::connection& conn);
 	void PostEvent(const std::string& evt); // helper for WorkItems
+	// helpers for WorkItems, user requests are counted from queueing until they finished
+	void BeginUserRequest();
+	void EndUserRequest();
+	bool HasUserRequests() const
+	{
+		return m_user_requests > 0;
+	}
+	void PrefetchBattleMapDone(const std::string& mapname, bool fetched);
+	void AnalyzeMapDone(const boost::shared_ptr<const ArchiveCatalog>& catalog, size_t index);
 
 	void LoadUnitSyncLibAsync(const std::string& filename);
 
@@ -116,6 +325,18 @@ public:
 	void GetMetalmapAsync(const std::string& mapname, int width, int height);
 	void GetHeightmapAsync(const std::string& mapname, int width, int height);
 
+	//! estimated memory used by all caches in bytes
+	size_t GetCacheMemoryUsage() const;
+	//! cache name -> estimated memory usage in bytes
+	std::map<std::string, size_t> GetCacheMemoryUsageByCache() const;
+	//! memory budget for all caches in bytes, 0 disables the limit
+	void SetCacheMemoryBudget(size_t bytes);
+
+	/** declares the maps currently visible to the user: queued async requests for them
+	 * run before all others, queued image requests of other maps are dropped
+	 * (an empty event is posted for each). An empty set turns this off. */
+	void SetVisibleMaps(const StringSet& mapnames);
+
 private:
 	void ClearCache();
 	void GetMinimapAsync(const std::string& mapname);
@@ -133,55 +354,129 @@ private:
 	UnitsyncImage GetHeightmap(const std::string& mapname);
 
 	bool FileExists(const std::string& name) const;
+	//! all spring data dirs
+	StringVector GetDataDirs() const;
 	std::string GetTextfileAsString(const std::string& gamename, const std::string& file_path);
 
 	StringVector GetMapDeps(const std::string& name);
 
 	UnitsyncImage GetImage(const std::string& gamename, const std::string& image_path, bool useWhiteAsTransparent = true) const;
+	//! SidePics/<side>.png or .bmp from the game archive
+	UnitsyncImage LoadSidePicture(const std::string& gamename, const std::string& sidename) const;
 
-	LocalArchivesVector m_maps_list;	 /// mapname -> hash
-	LocalArchivesVector m_mods_list;	 /// gamename -> hash
-	LocalArchivesVector m_mods_archive_name; /// gamename -> archive name
-	LocalArchivesVector m_maps_archive_name; /// mapname -> archive name
-	StringVector m_map_array;		 // this vector is CUSTOM SORTED ALPHABETICALLY, DON'T USE TO ACCESS UNITSYNC DIRECTLY
-	StringVector m_mod_array;		 // this vector is CUSTOM SORTED ALPHABETICALLY, DON'T USE TO ACCESS UNITSYNC DIRECTLY
-	StringVector m_unsorted_map_array;       // this is because unitsync doesn't have a search map index by name ..
-	StringVector m_unsorted_mod_array;       // this isn't necessary but makes things more symmetrical :P
-
-	/// caches sett().GetCachePath(), because that method calls back into
-	/// susynclib(), there's a good chance main thread blocks on some
-	/// WorkerThread operation... cache is invalidated on reload.
-	std::string m_cache_path;
-	std::map<std::string, GameOptions> m_map_gameoptions;
-	std::map<std::string, GameOptions> m_game_gameoptions;
+	/// only accessed with boost::atomic_load / atomic_store, see GetCatalog()
+	boost::shared_ptr<const ArchiveCatalog> m_catalog;
+	boost::mutex m_aicatalog_lock;
+	//! catalog of the game last passed to GetAIList(), GetAIInfos(int) indexes into it
+	boost::shared_ptr<const AICatalog> m_last_aicatalog;
 
 	mutable boost::mutex m_lock;
 	WorkerThread* m_cache_thread;
 	StringSignalType m_async_ops_complete_sig;
 
+	Util::DirWatcher* m_datadir_watcher;
+	//! drops everything cached in memory about the map, cache files are named by checksum and stay valid
+	void InvalidateMap(const std::string& mapname);
+	void InvalidateGame(const std::string& gamename);
+
+	/// all caches below account their memory against this budget
+	MemoryGovernor m_memory_governor;
+
 	/// this cache facilitates async image fetching (image is stored in cache
 	/// in background thread, then main thread gets it from cache)
 	MostRecentlyUsedImageCache m_map_image_cache;
 	/// this cache is a real cache, it stores minimaps with max size 100x100
 	MostRecentlyUsedImageCache m_tiny_minimap_cache;
 
-	/// this caches MapInfo to facilitate GetMapExAsync
+	/// fixed size part of the MapInfo of every map seen
+	MostRecentlyUsedMapSummaryCache m_mapsummary_cache;
+	/// full MapInfo of recently used maps to facilitate GetMapExAsync,
+	/// others are read from the cache file again when needed
 	MostRecentlyUsedMapInfoCache m_mapinfo_cache;
 
 	MostRecentlyUsedArrayStringCache m_sides_cache;
+	MostRecentlyUsedUnitIndexCache m_unitindex_cache;
+	MostRecentlyUsedSideAtlasCache m_sideatlas_cache;
+	MostRecentlyUsedArrayStringCache m_validmaps_cache;
+	MostRecentlyUsedAICatalogCache m_aicatalog_cache;
+	/// about 8MB each for the largest maps
+	MostRecentlyUsedRawHeightmapCache m_rawheightmap_cache;
+	MostRecentlyUsedMetalSpotsCache m_metalspots_cache;
+	MostRecentlyUsedTerrainStatsCache m_terrainstats_cache;
+	MostRecentlyUsedArchiveIndexCache m_archiveindex_cache;
+	MostRecentlyUsedGameOptionsCache m_map_gameoptions;
+	MostRecentlyUsedGameOptionsCache m_game_gameoptions;
+
+	//! incremented whenever MapInfo of a map was fetched from unitsync or the map table reset
+	std::atomic<unsigned int> m_mapinfo_generation;
+	boost::mutex m_maptable_lock;
+	boost::shared_ptr<const MapTable> m_map_table;
+	unsigned int m_map_table_generation;
+	//! m_map_table was built with fetchmissing
+	bool m_map_table_fetched;
+	//! checksums of the maps GetMapInfos() failed on, they aren't fetched again
+	boost::mutex m_mapinfo_failed_lock;
+	std::set<std::string> m_mapinfo_failed;
+	bool HasMapInfoFailed(const std::string& hash);
+
+	struct PrefetchCandidate
+	{
+		int users;
+		double lastseen; //! seconds since m_prefetch_epoch
+	};
+	boost::mutex m_prefetch_lock;
+	std::map<std::string, PrefetchCandidate> m_prefetch_candidates;
+	std::set<std::string> m_prefetch_queued;
+	//! subset of m_prefetch_candidates
+	std::set<std::string> m_prefetch_done;
+	size_t m_prefetch_maxqueued;
+	size_t m_prefetch_maxmemory;
+	boost::posix_time::ptime m_prefetch_epoch;
+	//! number of queued or running async requests of the user
+	std::atomic<int> m_user_requests;
+	//! queues the best prefetch candidates until the budget is used up
+	void SchedulePrefetch();
+	double PrefetchTime() const;
+	//! resident memory of the caches the prefetcher fills
+	size_t PrefetchMemoryUsage() const;
+
+	ReplayIndex m_replay_index;
+
+	boost::mutex m_visible_lock;
+	StringSet m_visible_maps;
+	//! priority of an async request, raised if the map is visible
+	int GetAsyncPriority(const std::string& mapname, int priority);
 
 	//! this function returns only the cache path without the file extension,
-	//! the extension itself would be added in the function as needed
-	std::string GetFileCachePath(const std::string& archivename, bool IsGame, bool usehash = true);
+	//! the extension itself would be added in the function as needed.
+	//! The file is named by the archive checksum, by name if it isn't known
+	std::string GetFileCachePath(const std::string& archivename, bool IsGame);
+	//! path in the shared cache dir for a path in the own cache dir, empty if there is none
+	std::string GetSharedCacheFile(const std::string& path) const;
+	//! path if it exists, else the shared cache file if that exists, else path
+	std::string FindCacheFile(const std::string& path) const;
+
+	mutable boost::mutex m_shared_cache_lock;
+	std::string m_shared_cache_path;
 
 	bool _LoadUnitSyncLib(const std::string& unitsyncloc);
 	void _FreeUnitSyncLib();
 
 	MapInfo _GetMapInfoEx(const std::string& mapname);
+	//! MapInfo from the mru or the cache file, false if unitsync would have to be asked
+	bool _GetCachedMapInfo(const std::string& mapname, MapInfo& info);
+	bool _GetCachedMapSummary(const std::string& mapname, MapSummary& summary);
+	//! parses the .mapinfo cache file, description, author and positions only if info isn't NULL
+	bool _ReadMapInfoCache(const std::string& mapname, MapSummary& summary, MapInfo* info);
+	//! writes the .mapinfo cache file and adds info to the mru caches
+	void _WriteMapInfoCache(const std::string& mapname, const MapInfo& info);
 
-	void PopulateArchiveList();
+	//! builds the catalog of the loaded unitsync
+	boost::shared_ptr<const ArchiveCatalog> PopulateArchiveList();
 
 	UnitsyncImage _GetMapImage(const std::string& mapname, const std::string& imagename, UnitsyncImage (UnitsyncLib::*loadMethod)(const std::string&));
+	//! persist false doesn't write the cache file, the analysis sweep would fill the disk with heightmaps
+	boost::shared_ptr<const RawHeightmap> _GetRawHeightmap(const std::string& mapname, bool persist);
 	UnitsyncImage _GetScaledMapImage(const std::string& mapname, UnitsyncImage (Unitsync::*loadMethod)(const std::string&), int width, int height);
 
 	void _GetMapImageAsync(const std::string& mapname, UnitsyncImage (Unitsync::*loadMethod)(const std::string&));
@@ -189,23 +484,14 @@ private:
 	friend Unitsync& usync();
 
 private:
-	//! returns an array where each element is a line of the file
-	bool GetCacheFile(const std::string& path, StringVector& ret) const;
+	//! returns an array where each element is a line of the file, at most maxlines lines if not 0
+	bool GetCacheFile(const std::string& path, StringVector& ret, size_t maxlines = 0) const;
 	//! write a file where each element of the array is a line
 	void SetCacheFile(const std::string& path, const StringVector& data);
 };
 
 Unitsync& usync();
 
-struct GameOptions
-{
-	OptionMapBool bool_map;
-	OptionMapFloat float_map;
-	OptionMapString string_map;
-	OptionMapList list_map;
-	OptionMapSection section_map;
-};
-
 /// Helper class for managing async operations safely
 class UnitSyncAsyncOps : public boost::noncopyable
 {
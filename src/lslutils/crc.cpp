@@ -3,15 +3,54 @@
 #include "crc.h"
 
 #include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "misc.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LSL_CRC_PCLMUL
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__linux__) && (defined(__clang__) || __GNUC__ >= 9)
+#define LSL_CRC_ARMV8
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#ifdef __clang__
+#define LSL_CRC_ARMV8_TARGET __attribute__((target("crc")))
+#else
+#define LSL_CRC_ARMV8_TARGET __attribute__((target("+crc")))
+#endif
+#endif
+
+#if !defined(WIN32) && !defined(_WIN32)
+#define LSL_CRC_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 //namespace LSL {
 
-unsigned int CRC::crcTable[256];
+//! crcTable[0] is the classic byte table, crcTable[1..7] the slicing-by-8 tables
+static unsigned int crcTable[8][256];
+
+//! function processing len bytes, crc is the internal (inverted) state
+typedef unsigned int (*CRCUpdateFunc)(unsigned int crc, const unsigned char* buf, size_t len);
 
+//! size of the file chunks mapped / read at once
+static const size_t FILE_CHUNK_SIZE = 64 * 1024 * 1024;
 
-/** @brief Generate the lookup table used for CRC calculation.
+
+/** @brief Generate the lookup tables used for CRC calculation.
     Code taken from http://paul.rutgers.edu/~rhoads/Code/crc-32b.c */
-void CRC::GenerateCRCTable()
+static void GenerateCRCTable()
 {
 	unsigned int crc, poly;
 	int i, j;
@@ -25,27 +64,201 @@ void CRC::GenerateCRCTable()
 			else
 				crc >>= 1;
 		}
-		crcTable[i] = crc;
+		crcTable[0][i] = crc;
+	}
+	for (i = 0; i < 256; i++) {
+		for (j = 1; j < 8; j++) {
+			crcTable[j][i] = (crcTable[j - 1][i] >> 8) ^ crcTable[0][crcTable[j - 1][i] & 0xFF];
+		}
+	}
+}
+
+static inline unsigned int ReadLE32(const unsigned char* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+//! slicing-by-8, processes 8 bytes per step with 8 table lookups
+static unsigned int UpdateTable(unsigned int crc, const unsigned char* buf, size_t len)
+{
+	const unsigned int(*table)[256] = crcTable;
+	while (len >= 8) {
+		const unsigned int one = crc ^ ReadLE32(buf);
+		const unsigned int two = ReadLE32(buf + 4);
+		crc = table[7][one & 0xFF] ^ table[6][(one >> 8) & 0xFF] ^ table[5][(one >> 16) & 0xFF] ^ table[4][one >> 24] ^
+		      table[3][two & 0xFF] ^ table[2][(two >> 8) & 0xFF] ^ table[1][(two >> 16) & 0xFF] ^ table[0][two >> 24];
+		buf += 8;
+		len -= 8;
+	}
+	while (len-- > 0)
+		crc = (crc >> 8) ^ table[0][(crc ^ *buf++) & 0xFF];
+	return crc;
+}
+
+#ifdef LSL_CRC_PCLMUL
+//! below this the setup of the folding isn't worth it
+static const size_t PCLMUL_MIN_LENGTH = 64;
+
+/** carry-less multiplication folding, see Intel's "Fast CRC Computation for
+    Generic Polynomials Using PCLMULQDQ Instruction".
+    len has to be >= 64 and a multiple of 16 */
+__attribute__((target("pclmul,sse4.1"))) static unsigned int FoldPCLMUL(unsigned int crc, const unsigned char* buf, size_t len)
+{
+	const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL);
+	const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+	const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124LL);
+	const __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+	const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+	__m128i x1 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+	__m128i x2 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+	__m128i x3 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+	__m128i x4 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+	buf += 64;
+	len -= 64;
+
+	// fold 4x128 bits per step
+	while (len >= 64) {
+		const __m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+		const __m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+		const __m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+		const __m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)(buf + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(buf + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(buf + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(buf + 0x30)));
+		buf += 64;
+		len -= 64;
+	}
+
+	// fold into 128 bits
+	__m128i x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+	// remaining 16 byte blocks
+	while (len >= 16) {
+		x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i*)buf)), x5);
+		buf += 16;
+		len -= 16;
+	}
+
+	// fold 128 to 64 bits
+	x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, mask32);
+	x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	// barrett reduction to 32 bits
+	x2 = _mm_and_si128(x1, mask32);
+	x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+	x2 = _mm_and_si128(x2, mask32);
+	x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+	return _mm_extract_epi32(x1, 1);
+}
+
+static unsigned int UpdatePCLMUL(unsigned int crc, const unsigned char* buf, size_t len)
+{
+	if (len >= PCLMUL_MIN_LENGTH) {
+		const size_t chunk = len & ~(size_t)15;
+		crc = FoldPCLMUL(crc, buf, chunk);
+		buf += chunk;
+		len -= chunk;
+	}
+	return UpdateTable(crc, buf, len);
+}
+
+static bool HasPCLMUL()
+{
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return false;
+	return (ecx & bit_PCLMUL) && (ecx & bit_SSE4_1);
+}
+#endif
+
+#ifdef LSL_CRC_ARMV8
+//! crc32 instructions of ARMv8, 8 bytes per instruction
+LSL_CRC_ARMV8_TARGET static unsigned int UpdateARMv8(unsigned int crc, const unsigned char* buf, size_t len)
+{
+	while (len > 0 && ((size_t)buf & 7) != 0) {
+		crc = __crc32b(crc, *buf++);
+		len--;
 	}
+	while (len >= 8) {
+		crc = __crc32d(crc, *(const unsigned long long*)buf);
+		buf += 8;
+		len -= 8;
+	}
+	while (len-- > 0)
+		crc = __crc32b(crc, *buf++);
+	return crc;
+}
+
+static bool HasARMv8CRC()
+{
+	return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
 }
+#endif
 
+struct CRCImplementation
+{
+	CRCUpdateFunc update;
+	const char* name;
+};
 
-/** @brief Construct a new CRC object.
-    This generates the CRC table if it is the first CRC object being
-	constructed. */
+//! generates the tables and picks the fastest implementation the cpu supports, once
+static const CRCImplementation& GetImpl()
+{
+	static const CRCImplementation impl = []() {
+		GenerateCRCTable();
+		CRCImplementation ret = {UpdateTable, "table"};
+#ifdef LSL_CRC_PCLMUL
+		if (HasPCLMUL()) {
+			ret.update = UpdatePCLMUL;
+			ret.name = "pclmul";
+		}
+#endif
+#ifdef LSL_CRC_ARMV8
+		if (HasARMv8CRC()) {
+			ret.update = UpdateARMv8;
+			ret.name = "armv8";
+		}
+#endif
+		return ret;
+	}();
+	return impl;
+}
+
+
+/** @brief Construct a new CRC object. */
 CRC::CRC()
     : crc(0xFFFFFFFF)
 {
-	if (crcTable[1] == 0)
-		GenerateCRCTable();
+	GetImpl();
 }
 
 
 /** @brief Update CRC over the data in buf. */
 void CRC::UpdateData(const unsigned char* buf, unsigned bytes)
 {
-	for (size_t i = 0; i < bytes; ++i)
-		crc = (crc >> 8) ^ crcTable[(crc ^ (buf[i])) & 0xFF];
+	crc = GetImpl().update(crc, buf, bytes);
 }
 
 /** @brief Resets CRC data to original state. */
@@ -62,24 +275,88 @@ void CRC::UpdateData(const std::string& buf)
 }
 
 
+const char* CRC::GetImplementation()
+{
+	return GetImpl().name;
+}
+
+
+#ifdef LSL_CRC_MMAP
+/** @brief maps the file chunk wise, avoids copying it through a buffer.
+    @return false if the file can't be mapped, crc is unchanged then */
+static bool UpdateFileMapped(int fd, unsigned long long size, unsigned int& crc)
+{
+	const CRCUpdateFunc update = GetImpl().update;
+	unsigned int ret = crc;
+	for (unsigned long long offset = 0; offset < size; offset += FILE_CHUNK_SIZE) {
+		const size_t len = (size_t)std::min<unsigned long long>(FILE_CHUNK_SIZE, size - offset);
+		void* data = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, (off_t)offset);
+		if (data == MAP_FAILED)
+			return false;
+		madvise(data, len, MADV_SEQUENTIAL);
+		ret = update(ret, (const unsigned char*)data, len);
+		munmap(data, len);
+	}
+	crc = ret;
+	return true;
+}
+#endif
+
+
 /** @brief Update CRC over the data in the specified file.
     @return true on success, false if file could not be opened. */
 bool CRC::UpdateFile(const std::string& filename)
 {
-	FILE* fp = fopen(filename.c_str(), "rb");
+#ifdef LSL_CRC_MMAP
+	const int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	const bool mapped = fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && UpdateFileMapped(fd, st.st_size, crc);
+	close(fd);
+	if (mapped)
+		return true;
+#endif
+	FILE* fp = LSL::Util::lslopen(filename, "rb");
 	if (!fp)
 		return false;
 
-	unsigned char buf[100000];
+	std::vector<unsigned char> buf(1024 * 1024);
 	size_t bytes;
 	do {
-		bytes = fread((void*)buf, 1, 100000, fp);
-		UpdateData(buf, bytes);
-	} while (bytes == 100000);
+		bytes = fread((void*)&buf[0], 1, buf.size(), fp);
+		UpdateData(&buf[0], bytes);
+	} while (bytes == buf.size());
 
 	fclose(fp);
 
 	return true;
 }
 
+
+std::map<std::string, unsigned int> CRC::GetFileCRCs(const std::vector<std::string>& filenames, int threads)
+{
+	if (threads <= 0)
+		threads = std::max(1u, boost::thread::hardware_concurrency());
+	threads = std::min<int>(threads, filenames.size());
+
+	std::map<std::string, unsigned int> ret;
+	boost::mutex lock;
+	std::atomic<size_t> next(0);
+	boost::thread_group group;
+	for (int t = 0; t < threads; t++) {
+		group.create_thread([&filenames, &ret, &lock, &next]() {
+			for (size_t i = next++; i < filenames.size(); i = next++) {
+				CRC crc;
+				if (!crc.UpdateFile(filenames[i]))
+					continue;
+				boost::mutex::scoped_lock l(lock);
+				ret[filenames[i]] = crc.GetCRC();
+			}
+		});
+	}
+	group.join_all();
+	return ret;
+}
+
 //} // namespace LSL
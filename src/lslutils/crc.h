@@ -4,6 +4,8 @@
 #define LSL_CRC_H
 
 #include <string>
+#include <vector>
+#include <map>
 
 //namespace LSL {
 
@@ -24,10 +26,14 @@ public:
 		return crc ^ 0xFFFFFFFF;
 	}
 
-private:
-	static unsigned int crcTable[256];
-	static void GenerateCRCTable();
+	/** @brief CRC-32 of many files, hashed in parallel by threads workers (0 = one per core).
+	    Files which couldn't be read are missing in the result. */
+	static std::map<std::string, unsigned int> GetFileCRCs(const std::vector<std::string>& filenames, int threads = 0);
+
+	//! name of the implementation chosen for this cpu, "table", "pclmul" or "armv8"
+	static const char* GetImplementation();
 
+private:
 	unsigned int crc;
 };
 
@@ -0,0 +1,102 @@
+/* This file is part of the Springlobby (GPL v2 or later), see COPYING */
+
+#include "demofile.h"
+
+#include <string.h>
+#include <zlib.h>
+
+#include "conversion.h"
+
+namespace LSL
+{
+namespace Util
+{
+
+static const char DEMO_MAGIC[] = "spring demofile";
+//! sanity limit, start scripts are a few KB
+static const int MAX_SCRIPT_SIZE = 1024 * 1024;
+//! zlib reads the file in chunks of this size
+static const unsigned int READ_BUFFER_SIZE = 4096;
+
+static int ReadInt(const unsigned char* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
+}
+
+static long long ReadInt64(const unsigned char* p)
+{
+	return (long long)((unsigned long long)(unsigned int)ReadInt(p) | ((unsigned long long)(unsigned int)ReadInt(p + 4) << 32));
+}
+
+//! reads exactly len bytes, gzread passes uncompressed files through
+static bool Read(gzFile file, void* buf, unsigned int len)
+{
+	return len == 0 || gzread(file, buf, len) == (int)len;
+}
+
+static bool ParseHeader(gzFile file, DemoHeader& header)
+{
+	// magic[16], version, headerSize, versionString[256], gameID[16], unixTime (int64),
+	// scriptSize, demoStreamSize, gameTime, wallclockTime, numPlayers, playerStatSize,
+	// playerStatElemSize, numTeams, teamStatSize, teamStatElemSize, teamStatPeriod,
+	// winningAllyTeamsSize
+	// versions < 5 have a versionString of 16 bytes
+	unsigned char buf[512];
+	if (!Read(file, buf, 24) || memcmp(buf, DEMO_MAGIC, sizeof(DEMO_MAGIC)) != 0)
+		return false;
+	header.version = ReadInt(buf + 16);
+	header.headersize = ReadInt(buf + 20);
+	const unsigned int versionlen = header.version >= 5 ? 256 : 16;
+	const unsigned int fields = 24 + versionlen + 16 + 8 + 12 * 4;
+	if (header.headersize < (int)fields || header.headersize > (int)sizeof(buf))
+		return false;
+	if (!Read(file, buf + 24, header.headersize - 24))
+		return false;
+
+	const char* version = (const char*)buf + 24;
+	header.engine = std::string(version, strnlen(version, versionlen));
+	static const char hex[] = "0123456789abcdef";
+	header.gameid.clear();
+	const unsigned char* gameid = buf + 24 + versionlen;
+	for (int i = 0; i < 16; i++) {
+		header.gameid += hex[gameid[i] >> 4];
+		header.gameid += hex[gameid[i] & 0xf];
+	}
+	const unsigned char* p = gameid + 16;
+	header.unixtime = ReadInt64(p);
+	header.scriptsize = ReadInt(p + 8);
+	header.demostreamsize = ReadInt(p + 12);
+	header.gametime = ReadInt(p + 16);
+	header.wallclocktime = ReadInt(p + 20);
+	header.numplayers = ReadInt(p + 24);
+	header.numteams = ReadInt(p + 36);
+	header.winningallyteamssize = ReadInt(p + 52);
+	return header.scriptsize >= 0 && header.scriptsize <= MAX_SCRIPT_SIZE;
+}
+
+bool ReadDemoHeader(const std::string& path, DemoHeader& header, std::string* script)
+{
+#ifdef WIN32
+	gzFile file = gzopen_w(Util::s2ws(path).c_str(), "rb");
+#else
+	gzFile file = gzopen(path.c_str(), "rb");
+#endif
+	if (file == NULL)
+		return false;
+	gzbuffer(file, READ_BUFFER_SIZE);
+	bool ok = ParseHeader(file, header);
+	if (ok && script != NULL) {
+		script->resize(header.scriptsize);
+		ok = header.scriptsize == 0 || Read(file, &(*script)[0], header.scriptsize);
+		if (ok) { // script is null terminated
+			script->resize(strnlen(script->c_str(), script->size()));
+		} else {
+			script->clear();
+		}
+	}
+	gzclose(file);
+	return ok;
+}
+
+} // namespace Util
+} // namespace LSL
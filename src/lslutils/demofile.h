@@ -0,0 +1,51 @@
+/* This file is part of the Springlobby (GPL v2 or later), see COPYING */
+
+#ifndef LSL_HEADERGUARD_DEMOFILE_H
+#define LSL_HEADERGUARD_DEMOFILE_H
+
+#include <string>
+
+namespace LSL
+{
+namespace Util
+{
+
+//! header of a spring replay (DemoFileHeader of the engine)
+struct DemoHeader
+{
+	DemoHeader()
+	    : version(0)
+	    , headersize(0)
+	    , unixtime(0)
+	    , scriptsize(0)
+	    , demostreamsize(0)
+	    , gametime(0)
+	    , wallclocktime(0)
+	    , numplayers(0)
+	    , numteams(0)
+	    , winningallyteamssize(0)
+	{
+	}
+	int version;
+	int headersize;
+	std::string engine; //! engine version string
+	std::string gameid; //! hex
+	long long unixtime; //! start of the game
+	int scriptsize;
+	int demostreamsize;
+	int gametime;      //! duration in game seconds
+	int wallclocktime; //! duration in real seconds
+	int numplayers;
+	int numteams;
+	int winningallyteamssize;
+};
+
+/** reads the header and (optionally) the start script of a .sdf or gzip
+ * compressed .sdfz replay. The file is streamed and only read up to the end
+ * of the script, usually a few KB. Returns false if it isn't a valid replay. */
+bool ReadDemoHeader(const std::string& path, DemoHeader& header, std::string* script = NULL);
+
+} // namespace Util
+} // namespace LSL
+
+#endif // LSL_HEADERGUARD_DEMOFILE_H
@@ -0,0 +1,170 @@
+/* This file is part of the Springlobby (GPL v2 or later), see COPYING */
+
+#include "dirwatcher.h"
+
+#include <set>
+#include <algorithm>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include "logging.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#endif
+
+namespace LSL
+{
+namespace Util
+{
+
+DirWatcher::DirWatcher()
+    : m_thread(NULL)
+    , m_debouncems(0)
+    , m_fd(-1)
+{
+	m_wakeup[0] = -1;
+	m_wakeup[1] = -1;
+}
+
+DirWatcher::~DirWatcher()
+{
+	Stop();
+}
+
+#ifdef __linux__
+
+bool DirWatcher::IsSupported()
+{
+	return true;
+}
+
+bool DirWatcher::Start(const std::vector<std::string>& dirs, const Callback& callback, int debouncems)
+{
+	Stop();
+	m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m_fd < 0) {
+		LslWarning("inotify_init1 failed: %s", strerror(errno));
+		return false;
+	}
+	// files are either written in place or moved there when complete
+	const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE;
+	for (const std::string& dir : dirs) {
+		const int wd = inotify_add_watch(m_fd, dir.c_str(), mask | IN_ONLYDIR);
+		if (wd < 0) {
+			LslDebug("Not watching %s: %s", dir.c_str(), strerror(errno));
+			continue;
+		}
+		m_dirs[wd] = dir;
+	}
+	if (m_dirs.empty() || pipe2(m_wakeup, O_CLOEXEC) != 0) {
+		Stop();
+		return false;
+	}
+	m_callback = callback;
+	m_debouncems = debouncems;
+	m_thread = new boost::thread(&DirWatcher::Run, this);
+	return true;
+}
+
+void DirWatcher::Stop()
+{
+	if (m_thread != NULL) {
+		const char c = 0;
+		if (write(m_wakeup[1], &c, 1) != 1) {
+			LslWarning("Couldn't wake up the directory watcher");
+		}
+		m_thread->join();
+		delete m_thread;
+		m_thread = NULL;
+	}
+	for (int* fd : {&m_fd, &m_wakeup[0], &m_wakeup[1]}) {
+		if (*fd >= 0)
+			close(*fd);
+		*fd = -1;
+	}
+	m_dirs.clear();
+	m_callback.clear();
+}
+
+void DirWatcher::Run()
+{
+	std::set<std::string> changed;
+	boost::posix_time::ptime lastevent;
+	// large enough for many events with long names
+	char buf[16 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+	while (true) {
+		int timeout = -1;
+		if (!changed.empty()) {
+			const boost::posix_time::time_duration quiet = boost::posix_time::microsec_clock::universal_time() - lastevent;
+			timeout = std::max<long>(0, m_debouncems - quiet.total_milliseconds());
+		}
+		pollfd fds[2];
+		fds[0].fd = m_fd;
+		fds[0].events = POLLIN;
+		fds[1].fd = m_wakeup[0];
+		fds[1].events = POLLIN;
+		const int ret = poll(fds, 2, timeout);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			LslWarning("poll failed in directory watcher: %s", strerror(errno));
+			return;
+		}
+		if (fds[1].revents != 0) // Stop()
+			return;
+		if (ret == 0) { // quiet for the debounce time
+			const std::vector<std::string> files(changed.begin(), changed.end());
+			changed.clear();
+			m_callback(files);
+			continue;
+		}
+		const ssize_t len = read(m_fd, buf, sizeof(buf));
+		if (len <= 0)
+			continue;
+		for (const char* ptr = buf; ptr < buf + len;) {
+			const inotify_event* event = reinterpret_cast<const inotify_event*>(ptr);
+			ptr += sizeof(inotify_event) + event->len;
+			if (event->mask & IN_Q_OVERFLOW) {
+				// events were lost, report the dirs themselves
+				for (const auto& dir : m_dirs)
+					changed.insert(dir.second);
+				continue;
+			}
+			const auto dir = m_dirs.find(event->wd);
+			if (dir == m_dirs.end() || event->len == 0)
+				continue;
+			changed.insert(dir->second + "/" + event->name);
+		}
+		lastevent = boost::posix_time::microsec_clock::universal_time();
+	}
+}
+
+#else
+
+bool DirWatcher::IsSupported()
+{
+	return false;
+}
+
+bool DirWatcher::Start(const std::vector<std::string>& /*dirs*/, const Callback& /*callback*/, int /*debouncems*/)
+{
+	return false;
+}
+
+void DirWatcher::Stop()
+{
+}
+
+void DirWatcher::Run()
+{
+}
+
+#endif
+
+} // namespace Util
+} // namespace LSL
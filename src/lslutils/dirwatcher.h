@@ -0,0 +1,56 @@
+/* This file is part of the Springlobby (GPL v2 or later), see COPYING */
+
+#ifndef LSL_HEADERGUARD_DIRWATCHER_H
+#define LSL_HEADERGUARD_DIRWATCHER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <boost/noncopyable.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace LSL
+{
+namespace Util
+{
+
+/** \brief watches directories for files being added, replaced or removed
+ *
+ * Events are collected until no new one arrived for the debounce time, then
+ * the callback is called from the watcher thread with the paths of all
+ * changed files. Only implemented with inotify on linux, elsewhere Start()
+ * fails. Subdirectories aren't watched.
+ */
+class DirWatcher : public boost::noncopyable
+{
+public:
+	typedef boost::function<void(const std::vector<std::string>& changed)> Callback;
+
+	DirWatcher();
+	~DirWatcher();
+
+	//! watches all of dirs which exist, false if none could be watched
+	bool Start(const std::vector<std::string>& dirs, const Callback& callback, int debouncems = 2000);
+	void Stop();
+	bool IsRunning() const
+	{
+		return m_thread != NULL;
+	}
+	static bool IsSupported();
+
+private:
+	void Run();
+
+	boost::thread* m_thread;
+	Callback m_callback;
+	int m_debouncems;
+	int m_fd;	//! inotify
+	int m_wakeup[2]; //! pipe to stop the thread
+	std::map<int, std::string> m_dirs; //! by watch descriptor
+};
+
+} // namespace Util
+} // namespace LSL
+
+#endif // LSL_HEADERGUARD_DIRWATCHER_H
@@ -37,6 +37,8 @@
   <ghost@aladdin.com>.  Other authors are noted in the change history
   that follows (in reverse chronological order):
 
+  lsl: take the byte order from the compiler's __BYTE_ORDER__ when
+	ARCH_IS_BIG_ENDIAN isn't given, avoids the runtime check per block.
   2002-04-13 lpd Clarified derivation from RFC 1321; now handles byte order
 	either statically or dynamically; added missing #include <string.h>
 	in library.
@@ -54,6 +56,10 @@
 #include "md5.h"
 #include <string.h>
 
+#if !defined(ARCH_IS_BIG_ENDIAN) && defined(__BYTE_ORDER__)
+#  define ARCH_IS_BIG_ENDIAN (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#endif
+
 #undef BYTE_ORDER	/* 1 = big-endian, -1 = little-endian, 0 = unknown */
 #ifdef ARCH_IS_BIG_ENDIAN
 #  define BYTE_ORDER (ARCH_IS_BIG_ENDIAN ? 1 : -1)
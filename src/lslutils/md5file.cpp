@@ -0,0 +1,373 @@
+/* This file is part of the Springlobby (GPL v2 or later), see COPYING */
+
+#include "md5file.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "md5.h"
+#include "misc.h"
+#include "debug.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define LSL_MD5_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace LSL
+{
+namespace Util
+{
+
+static const size_t MD5_BLOCK_SIZE = 64;
+//! files hashed at once by one worker
+static const size_t MD5_LANES = 4;
+//! bytes read from a file at once
+static const size_t READ_CHUNK_SIZE = 1024 * 1024;
+
+static std::string ToHex(const md5_byte_t digest[16])
+{
+	static const char hex[] = "0123456789abcdef";
+	std::string ret(32, '0');
+	for (int i = 0; i < 16; i++) {
+		ret[i * 2] = hex[digest[i] >> 4];
+		ret[i * 2 + 1] = hex[digest[i] & 0xf];
+	}
+	return ret;
+}
+
+std::string GetMD5(const void* buf, size_t len)
+{
+	md5_state_t state;
+	md5_init(&state);
+	const md5_byte_t* data = (const md5_byte_t*)buf;
+	while (len > 0) { // md5_append takes an int
+		const size_t n = std::min(len, READ_CHUNK_SIZE);
+		md5_append(&state, data, (int)n);
+		data += n;
+		len -= n;
+	}
+	md5_byte_t digest[16];
+	md5_finish(&state, digest);
+	return ToHex(digest);
+}
+
+#ifdef LSL_MD5_SSE2
+//! per step constants of RFC 1321, round by round
+static const md5_word_t MD5_T[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391};
+//! rotations per round
+static const int MD5_S[4][4] = {{7, 12, 17, 22}, {5, 9, 14, 20}, {4, 11, 16, 23}, {6, 10, 15, 21}};
+
+static inline int LoadWord(const md5_byte_t* p)
+{
+	int ret;
+	memcpy(&ret, p, sizeof(ret)); // x86 is little endian like md5
+	return ret;
+}
+
+/** runs the md5 compression function over blocks 64 byte blocks of four
+ *  independent messages at once, one message per 32 bit lane */
+static void ProcessBlocksX4(md5_word_t* state[MD5_LANES], const md5_byte_t* data[MD5_LANES], size_t blocks)
+{
+	__m128i a = _mm_set_epi32(state[3][0], state[2][0], state[1][0], state[0][0]);
+	__m128i b = _mm_set_epi32(state[3][1], state[2][1], state[1][1], state[0][1]);
+	__m128i c = _mm_set_epi32(state[3][2], state[2][2], state[1][2], state[0][2]);
+	__m128i d = _mm_set_epi32(state[3][3], state[2][3], state[1][3], state[0][3]);
+	const __m128i ones = _mm_set1_epi32(-1);
+	for (size_t block = 0; block < blocks; block++) {
+		const size_t offset = block * MD5_BLOCK_SIZE;
+		__m128i w[16];
+		for (int i = 0; i < 16; i++) {
+			w[i] = _mm_set_epi32(LoadWord(data[3] + offset + i * 4), LoadWord(data[2] + offset + i * 4),
+					     LoadWord(data[1] + offset + i * 4), LoadWord(data[0] + offset + i * 4));
+		}
+		const __m128i a0 = a, b0 = b, c0 = c, d0 = d;
+		for (int i = 0; i < 64; i++) {
+			__m128i f;
+			int k;
+			const int round = i / 16;
+			switch (round) {
+				case 0: // F = (b & c) | (~b & d)
+					f = _mm_xor_si128(d, _mm_and_si128(b, _mm_xor_si128(c, d)));
+					k = i;
+					break;
+				case 1: // G = (b & d) | (c & ~d)
+					f = _mm_xor_si128(c, _mm_and_si128(d, _mm_xor_si128(b, c)));
+					k = (1 + 5 * i) & 15;
+					break;
+				case 2: // H = b ^ c ^ d
+					f = _mm_xor_si128(_mm_xor_si128(b, c), d);
+					k = (5 + 3 * i) & 15;
+					break;
+				default: // I = c ^ (b | ~d)
+					f = _mm_xor_si128(c, _mm_or_si128(b, _mm_xor_si128(d, ones)));
+					k = (7 * i) & 15;
+					break;
+			}
+			const int s = MD5_S[round][i & 3];
+			__m128i t = _mm_add_epi32(_mm_add_epi32(a, f), _mm_add_epi32(w[k], _mm_set1_epi32(MD5_T[i])));
+			t = _mm_or_si128(_mm_sll_epi32(t, _mm_cvtsi32_si128(s)), _mm_srl_epi32(t, _mm_cvtsi32_si128(32 - s)));
+			a = d;
+			d = c;
+			c = b;
+			b = _mm_add_epi32(b, t);
+		}
+		a = _mm_add_epi32(a, a0);
+		b = _mm_add_epi32(b, b0);
+		c = _mm_add_epi32(c, c0);
+		d = _mm_add_epi32(d, d0);
+	}
+	md5_word_t out[4][MD5_LANES];
+	_mm_storeu_si128((__m128i*)out[0], a);
+	_mm_storeu_si128((__m128i*)out[1], b);
+	_mm_storeu_si128((__m128i*)out[2], c);
+	_mm_storeu_si128((__m128i*)out[3], d);
+	for (size_t lane = 0; lane < MD5_LANES; lane++) {
+		for (int i = 0; i < 4; i++) {
+			state[lane][i] = out[i][lane];
+		}
+	}
+}
+#endif
+
+//! a file being hashed, read in chunks of READ_CHUNK_SIZE
+class MD5Stream
+{
+public:
+	MD5Stream()
+	    : m_file(NULL)
+	    , m_pos(0)
+	    , m_len(0)
+	    , m_size(0)
+	{
+	}
+	~MD5Stream()
+	{
+		Close();
+	}
+
+	bool Open(const std::string& filename)
+	{
+		Close();
+		m_file = lslopen(filename, "rb");
+		if (m_file == NULL)
+			return false;
+		m_filename = filename;
+		m_buf.resize(READ_CHUNK_SIZE);
+		m_pos = m_len = 0;
+		m_size = 0;
+		md5_init(&m_state);
+		return true;
+	}
+	bool IsOpen() const
+	{
+		return m_file != NULL;
+	}
+
+	//! number of complete blocks available at Data(), 0 at the end of the file
+	size_t Blocks()
+	{
+		if (m_len - m_pos < MD5_BLOCK_SIZE)
+			Fill();
+		return (m_len - m_pos) / MD5_BLOCK_SIZE;
+	}
+	const md5_byte_t* Data() const
+	{
+		return m_buf.data() + m_pos;
+	}
+	//! the digest words, the md5 state never has buffered bytes while blocks are processed
+	md5_word_t* Words()
+	{
+		return m_state.abcd;
+	}
+	//! blocks were processed outside, updates position and message length
+	void Consumed(size_t blocks)
+	{
+		const size_t bytes = blocks * MD5_BLOCK_SIZE;
+		const md5_word_t nbits = (md5_word_t)(bytes << 3);
+		m_state.count[1] += (md5_word_t)(bytes >> 29);
+		m_state.count[0] += nbits;
+		if (m_state.count[0] < nbits)
+			m_state.count[1]++;
+		m_pos += bytes;
+	}
+	void ProcessScalar(size_t blocks)
+	{
+		md5_append(&m_state, Data(), (int)(blocks * MD5_BLOCK_SIZE));
+		m_pos += blocks * MD5_BLOCK_SIZE;
+	}
+
+	//! hashes the remaining bytes and closes the file, returns false on read errors
+	bool Finish(std::string& digest)
+	{
+		const bool ok = ferror(m_file) == 0;
+		md5_append(&m_state, Data(), (int)(m_len - m_pos));
+		md5_byte_t result[16];
+		md5_finish(&m_state, result);
+		digest = ToHex(result);
+		Close();
+		return ok;
+	}
+
+	const std::string& GetFilename() const
+	{
+		return m_filename;
+	}
+	unsigned long long GetSize() const
+	{
+		return m_size;
+	}
+
+private:
+	void Fill()
+	{
+		if (feof(m_file) || ferror(m_file))
+			return;
+		memmove(m_buf.data(), m_buf.data() + m_pos, m_len - m_pos);
+		m_len -= m_pos;
+		m_pos = 0;
+		const size_t read = fread(m_buf.data() + m_len, 1, m_buf.size() - m_len, m_file);
+		m_len += read;
+		m_size += read;
+	}
+	void Close()
+	{
+		if (m_file != NULL)
+			fclose(m_file);
+		m_file = NULL;
+	}
+
+	FILE* m_file;
+	std::string m_filename;
+	std::vector<md5_byte_t> m_buf;
+	size_t m_pos;
+	size_t m_len;
+	unsigned long long m_size;
+	md5_state_t m_state;
+};
+
+std::string GetFileMD5(const std::string& filename)
+{
+	MD5Stream stream;
+	if (!stream.Open(filename))
+		return "";
+	for (size_t blocks = stream.Blocks(); blocks > 0; blocks = stream.Blocks()) {
+		stream.ProcessScalar(blocks);
+	}
+	std::string ret;
+	if (!stream.Finish(ret))
+		return "";
+	return ret;
+}
+
+std::map<std::string, std::string> GetFileMD5s(const std::vector<std::string>& filenames, int threads, FileHashStats* stats)
+{
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (threads <= 0)
+		threads = std::max(1u, boost::thread::hardware_concurrency());
+	threads = std::max(1, std::min<int>(threads, filenames.size()));
+	// don't let a worker take four files while others idle
+	const size_t lanes = std::min(MD5_LANES, std::max<size_t>(1, filenames.size() / threads));
+
+	std::map<std::string, std::string> ret;
+	FileHashStats total;
+	boost::mutex lock;
+	std::atomic<size_t> next(0);
+	auto worker = [&]() {
+		MD5Stream streams[MD5_LANES];
+		// opens the next readable file in stream, false if there are none left
+		auto open = [&](MD5Stream& stream) {
+			for (size_t i = next++; i < filenames.size(); i = next++) {
+				if (stream.Open(filenames[i]))
+					return true;
+				boost::mutex::scoped_lock l(lock);
+				total.failed++;
+			}
+			return false;
+		};
+		auto finish = [&](MD5Stream& stream) {
+			std::string digest;
+			const std::string filename = stream.GetFilename();
+			const unsigned long long size = stream.GetSize();
+			const bool ok = stream.Finish(digest);
+			boost::mutex::scoped_lock l(lock);
+			if (ok) {
+				ret[filename] = digest;
+				total.files++;
+			} else {
+				total.failed++;
+			}
+			total.bytes += size;
+		};
+
+		for (size_t i = 0; i < lanes; i++) {
+			open(streams[i]);
+		}
+		for (;;) {
+			size_t active = 0;
+			size_t blocks = (size_t)-1;
+			for (size_t i = 0; i < lanes; i++) {
+				MD5Stream& stream = streams[i];
+				size_t n = stream.IsOpen() ? stream.Blocks() : 0;
+				while (stream.IsOpen() && n == 0) {
+					finish(stream);
+					if (open(stream))
+						n = stream.Blocks();
+				}
+				if (stream.IsOpen()) {
+					active++;
+					blocks = std::min(blocks, n);
+				}
+			}
+			if (active == 0)
+				break;
+#ifdef LSL_MD5_SSE2
+			if (active == MD5_LANES) {
+				md5_word_t* words[MD5_LANES];
+				const md5_byte_t* data[MD5_LANES];
+				for (size_t i = 0; i < MD5_LANES; i++) {
+					words[i] = streams[i].Words();
+					data[i] = streams[i].Data();
+				}
+				ProcessBlocksX4(words, data, blocks);
+				for (size_t i = 0; i < MD5_LANES; i++) {
+					streams[i].Consumed(blocks);
+				}
+				continue;
+			}
+#endif
+			for (size_t i = 0; i < lanes; i++) {
+				if (streams[i].IsOpen())
+					streams[i].ProcessScalar(streams[i].Blocks());
+			}
+		}
+	};
+
+	boost::thread_group group;
+	for (int t = 0; t < threads; t++) {
+		group.create_thread(worker);
+	}
+	group.join_all();
+
+	total.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	LslDebug("md5 of %d files (%d failed), %llu bytes in %.2fs: %.1f MB/s", (int)total.files, (int)total.failed, total.bytes, total.seconds, total.GetThroughput());
+	if (stats != NULL)
+		*stats = total;
+	return ret;
+}
+
+} // namespace Util
+} // namespace LSL
@@ -0,0 +1,49 @@
+/* This file is part of the Springlobby (GPL v2 or later), see COPYING */
+
+#ifndef LSL_HEADERGUARD_MD5FILE_H
+#define LSL_HEADERGUARD_MD5FILE_H
+
+#include <string>
+#include <vector>
+#include <map>
+
+namespace LSL
+{
+namespace Util
+{
+
+//! md5 of buf as lowercase hex
+std::string GetMD5(const void* buf, size_t len);
+
+//! md5 of a file as lowercase hex, empty if it couldn't be read
+std::string GetFileMD5(const std::string& filename);
+
+struct FileHashStats
+{
+	FileHashStats()
+	    : files(0)
+	    , failed(0)
+	    , bytes(0)
+	    , seconds(0.0)
+	{
+	}
+	size_t files;
+	size_t failed;
+	unsigned long long bytes;
+	double seconds; //! wall clock time
+	//! MB/s
+	double GetThroughput() const
+	{
+		return seconds > 0.0 ? bytes / (1024.0 * 1024.0) / seconds : 0.0;
+	}
+};
+
+/** md5 of many files as lowercase hex by filename, unreadable files are
+ *  missing in the result. threads workers (0 = one per core) each hash four
+ *  files at once with a multi-buffer SSE2 md5 where available. */
+std::map<std::string, std::string> GetFileMD5s(const std::vector<std::string>& filenames, int threads = 0, FileHashStats* stats = NULL);
+
+} // namespace Util
+} // namespace LSL
+
+#endif // LSL_HEADERGUARD_MD5FILE_H
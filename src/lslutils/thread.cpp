@@ -67,6 +67,34 @@ bool WorkItemQueue::Remove(WorkItem* item)
 	return true;
 }
 
+void WorkItemQueue::Reprioritize(const ReprioritizeFunc& func)
+{
+	std::vector<WorkItem*> dropped;
+	{
+		boost::mutex::scoped_lock lock(m_lock);
+		std::vector<WorkItem*> kept;
+		kept.reserve(m_queue.size());
+		for (WorkItem* item : m_queue) {
+			if (func(item, item->m_priority)) {
+				kept.push_back(item);
+			} else {
+				item->m_queue = NULL;
+				dropped.push_back(item);
+			}
+		}
+		m_queue.swap(kept);
+		std::make_heap(m_queue.begin(), m_queue.end(), WorkItemCompare());
+	}
+	for (WorkItem* item : dropped) {
+		try {
+			item->Discarded();
+		} catch (std::exception& e) {
+			LslDebug("WorkItemQueue caught exception thrown by WorkItem::Discarded -- %s", e.what());
+		}
+		CleanupWorkItem(item);
+	}
+}
+
 void WorkItemQueue::Cancel()
 {
 	m_dying = true;
@@ -87,6 +115,11 @@ void WorkerThread::DoWork(WorkItem* item, int priority, bool toBeDeleted)
 	m_workeritemqueue.Push(item);
 }
 
+void WorkerThread::Reprioritize(const WorkItemQueue::ReprioritizeFunc& func)
+{
+	m_workeritemqueue.Reprioritize(func);
+}
+
 void WorkerThread::Wait()
 {
 	m_workeritemqueue.Cancel(); //don't start new tasks / wake up worker thread
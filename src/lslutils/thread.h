@@ -7,6 +7,7 @@
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/noncopyable.hpp>
+#include <boost/function.hpp>
 #include <vector>
 
 namespace LSL
@@ -36,6 +37,12 @@ public:
 	/** @brief Implement this in derived class to do the work */
 	virtual void Run() = 0;
 
+	/** @brief Called instead of Run() when the item was dropped by
+	    WorkItemQueue::Reprioritize, before it is deleted */
+	virtual void Discarded()
+	{
+	}
+
 	/** @brief Cancel this WorkItem, remove it from queue
         @return true if it was removed, false otherwise */
 	bool Cancel();
@@ -73,6 +80,13 @@ public:
 	//! dangerous
 	void Cancel();
 
+	/** @brief Callback for Reprioritize, may change the priority of the item,
+	    returns false to drop it. Called with the queue locked, must not access the queue. */
+	typedef boost::function<bool(WorkItem* item, int& priority)> ReprioritizeFunc;
+	/** @brief Passes all queued items to func and restores the heap afterwards,
+	    dropped items get Discarded() called outside of the lock */
+	void Reprioritize(const ReprioritizeFunc& func);
+
 private:
 	/** @brief Pop one work item from the queue
         @return A work item or NULL when the queue is empty */
@@ -99,6 +113,8 @@ public:
 	~WorkerThread();
 	/** @brief Adds a new WorkItem to the queue */
 	void DoWork(WorkItem* item, int priority = 0, bool toBeDeleted = true);
+	/** @brief Changes priorities of or drops queued WorkItems, see WorkItemQueue::Reprioritize */
+	void Reprioritize(const WorkItemQueue::ReprioritizeFunc& func);
 	//! joins underlying thread
 	void Wait();
 
@@ -0,0 +1,118 @@
+/* This file is part of the Springlobby (GPL v2 or later), see COPYING */
+
+#include <lslutils/demofile.h>
+
+#include <stdexcept>
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "common.h"
+
+#include <iostream>
+
+#define CHECK(cond)                                                   \
+	if (!(cond)) {                                                \
+		throw TestFailedException("check failed: " #cond); \
+	}
+
+static void WriteInt(unsigned char* p, int value)
+{
+	p[0] = value & 0xff;
+	p[1] = (value >> 8) & 0xff;
+	p[2] = (value >> 16) & 0xff;
+	p[3] = (value >> 24) & 0xff;
+}
+
+//! a version 5 DemoFileHeader, every int field holds a distinct value
+static std::string BuildDemo(const std::string& script)
+{
+	const int headersize = 24 + 256 + 16 + 8 + 12 * 4;
+	unsigned char header[headersize];
+	memset(header, 0, sizeof(header));
+	memcpy(header, "spring demofile", 16);
+	WriteInt(header + 16, 5);
+	WriteInt(header + 20, headersize);
+	memcpy(header + 24, "105.0", 5);
+	for (int i = 0; i < 16; i++)
+		header[280 + i] = i * 0x11;
+	unsigned char* p = header + 296;
+	WriteInt(p, 1500000000); // unixTime
+	WriteInt(p + 4, 0);
+	const int fields[12] = {
+	    (int)script.size() + 1, // scriptSize, null terminated
+	    123456,		    // demoStreamSize
+	    1800,		    // gameTime
+	    1850,		    // wallclockTime
+	    6,			    // numPlayers
+	    1001,		    // playerStatSize
+	    1002,		    // playerStatElemSize
+	    4,			    // numTeams
+	    1003,		    // teamStatSize
+	    1004,		    // teamStatElemSize
+	    16,			    // teamStatPeriod
+	    2,			    // winningAllyTeamsSize
+	};
+	for (int i = 0; i < 12; i++)
+		WriteInt(p + 8 + i * 4, fields[i]);
+	std::string demo((const char*)header, headersize);
+	CHECK(demo.size() == 352);
+	demo += script;
+	demo += '\0';
+	demo += "demo stream";
+	return demo;
+}
+
+static void CheckHeader(const std::string& path, const std::string& script)
+{
+	LSL::Util::DemoHeader header;
+	std::string readscript;
+	CHECK(LSL::Util::ReadDemoHeader(path, header, &readscript));
+	CHECK(header.version == 5);
+	CHECK(header.headersize == 352);
+	CHECK(header.engine == "105.0");
+	CHECK(header.gameid == "00112233445566778899aabbccddeeff");
+	CHECK(header.unixtime == 1500000000);
+	CHECK(header.scriptsize == (int)script.size() + 1);
+	CHECK(header.demostreamsize == 123456);
+	CHECK(header.gametime == 1800);
+	CHECK(header.wallclocktime == 1850);
+	CHECK(header.numplayers == 6);
+	CHECK(header.numteams == 4);
+	CHECK(header.winningallyteamssize == 2);
+	CHECK(readscript == script);
+}
+
+int main(int, char**)
+{
+	const std::string script = "[game]\n{\n\tmapname=Test;\n}\n";
+	const std::string demo = BuildDemo(script);
+
+	const std::string sdf = "lsl_demofile_test.sdf";
+	FILE* file = fopen(sdf.c_str(), "wb");
+	CHECK(file != NULL);
+	CHECK(fwrite(demo.data(), 1, demo.size(), file) == demo.size());
+	fclose(file);
+	CheckHeader(sdf, script);
+	remove(sdf.c_str());
+
+	const std::string sdfz = "lsl_demofile_test.sdfz";
+	gzFile gz = gzopen(sdfz.c_str(), "wb");
+	CHECK(gz != NULL);
+	CHECK(gzwrite(gz, demo.data(), demo.size()) == (int)demo.size());
+	gzclose(gz);
+	CheckHeader(sdfz, script);
+	remove(sdfz.c_str());
+
+	// truncated header
+	file = fopen(sdf.c_str(), "wb");
+	CHECK(file != NULL);
+	CHECK(fwrite(demo.data(), 1, 300, file) == 300);
+	fclose(file);
+	LSL::Util::DemoHeader header;
+	CHECK(!LSL::Util::ReadDemoHeader(sdf, header));
+	remove(sdf.c_str());
+
+	std::cout << "demofile test passed" << std::endl;
+	return 0;
+}